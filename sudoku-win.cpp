@@ -1,43 +1,527 @@
 #include <iostream> // for input and output
+#include <fstream>  // for archive files
+#include <chrono>   // for timing batch modes
+#include <string>   // for strings
+#include <array>    // for fixed-size arrays
 #include <vector>   // for dynamic arrays
 #include <cstdlib>  // for system function like cls to clear the screen
 #include <ctime>    // for time function
-#include <cmath>    // for math functions like rand function
+#include <random>   // for the random number engine
+#include <thread>   // for worker threads and pacing the engine benchmark
+#include <atomic>   // for handing out work between threads
+#include <bitset>   // for clue masks
+#include <limits>   // for numeric_limits
+#include <algorithm> // for sort
+#include <cmath>    // for log2
+#include <cstdio>   // for snprintf
 
-#define N 9             // Size of the board
-#define MINI_BOX_SIZE 3 // Size of the mini box 3x3
-#define EASY_LVL 13     // Number of empty cells for easy level
-#define MEDIUM_LVL 29   // Number of empty cells for medium level
-#define HARD_LVL 41     // Number of empty cells for hard level
+#ifndef MINI_BOX_SIZE
+#define MINI_BOX_SIZE 3 // Size of the mini box 3x3, build with -DMINI_BOX_SIZE=4 to 8 for 16x16 up to 64x64
+#endif
+#define N (MINI_BOX_SIZE * MINI_BOX_SIZE) // Size of the board
+#define EASY_LVL (13 * N * N / 81)        // Number of empty cells for easy level
+#define MEDIUM_LVL (29 * N * N / 81)      // Number of empty cells for medium level
+#define HARD_LVL (41 * N * N / 81)        // Number of empty cells for hard level
+
+#define ALL_CANDIDATES (~Mask(0) >> (8 * sizeof(Mask) - N)) // One bit for each digit 1..N
+
+#define FILL_NODE_BUDGET (2 * N * N) // Search nodes fillGrid spends on one diagonal seeding before it restarts
+
+#define REPAIR_SOLUTIONS 64              // Solutions enumerated per repairPuzzle round
+#define REPAIR_NODE_BUDGET (2 * N * N)   // Search nodes per repairPuzzle round when generating puzzles
+#define EXPLAIN_NODE_BUDGET 5000         // Search nodes per check in explainContradiction
+#define ENGINE_NODE_BUDGET 20000         // Search nodes per solve an engine command may spend before it gives up
+#define PATTERN_TRANSFORMS 64            // Transformed copies of each grid tried against a clue mask
+
+#define BRANCH_FIRST_EMPTY 0   // Solver branches on the first empty cell in row order
+#define BRANCH_CELL 1          // Solver branches on the cell with the fewest candidates
+#define BRANCH_HIDDEN_SINGLE 2 // ... or on the digit with the fewest places in a unit, if fewer
+
+#define TRIAL_STEPS 20             // Placements each trial branch may propagate before it is cut off
+#define TRIAL_BUDGET (10 * N * N)  // Tentative placements allowed per rating, or per search node when pruning
+
+#define ESTIMATE_RUNS 16      // Randomized solver runs behind one difficulty estimate
+#define ESTIMATE_RUNS_MAX 256 // Most runs estimateDifficulty will do
+
+#define TECHNIQUE_SINGLES 0 // Naked and hidden singles solve the puzzle
+#define TECHNIQUE_TRIAL 1   // Trial propagation is needed too
+#define TECHNIQUE_SEARCH 2  // Neither is enough, it takes guessing
+
+#define CONSTRAINT_THERMO 0   // Digits strictly increase from the bulb, the first cell, along the path
+#define CONSTRAINT_ARROW 1    // Digits on the path add up to the digit in the circle, the first cell
+#define CONSTRAINT_SANDWICH 2 // Digits between the 1 and the N of a row or column add up to the clue
+
+#define VARIANT_CONSTRAINTS 2 // Thermometers, arrows and sandwich clues each in a variant newgame
+#define VARIANT_TRIES 50      // Random walks tried for each generated thermometer or arrow
+
+#define SOLVER_BENCH_NODE_BUDGET 2000000 // Search nodes per puzzle before --solver-bench gives up
+#define BENCH_SPIN_MICROSECONDS 200      // Time before each scheduled engine request spent spinning, not asleep
+
+#define ARCHIVE_RECORD_MAX (2 * N * N) // Upper bound on the size of one archive record in bytes
+#define ARCHIVE_CHUNK 4096             // Records per length-prefixed archive chunk, what --analyze hands a worker
 
 using namespace std;
 
+static_assert(MINI_BOX_SIZE >= 2 && MINI_BOX_SIZE <= 8, "Candidate masks hold at most 64 digits, so boxes go up to 8x8");
+
+// Candidate digits of a cell or unit, digit num in bit num - 1
+#if N > 32
+typedef unsigned long long Mask;
+#else
+typedef unsigned int Mask;
+#endif
+
+// Archive coder state, wide enough for ARCHIVE_STATE_LOW * 256 * N. Past 36x36 that takes a
+// compiler with 128-bit integers (GCC or Clang).
+#if N > 36
+typedef unsigned __int128 ArchiveState;
+#else
+typedef unsigned long long ArchiveState;
+#endif
+
+// A whole board stored inline, so copying a puzzle never allocates
+typedef array<array<int, N>, N> Grid;
+
 // Function to clear the screen
 void clearScreen()
 {
     system("cls");
 }
 
+// Parse up to maxCount whole numbers from line, starting at pos, into values.
+// Returns how many numbers were found, or 0 if the line holds anything else.
+int parseNumbers(const string &line, size_t pos, int *values, int maxCount)
+{
+    int count = 0;
+    while (true)
+    {
+        while (pos < line.size() && (line[pos] == ' ' || line[pos] == '\t' || line[pos] == ',' || line[pos] == '\r'))
+            pos++;
+        if (pos == line.size())
+            return count;
+        if (line[pos] < '0' || line[pos] > '9' || count == maxCount)
+            return 0;
+
+        int value = 0;
+        while (pos < line.size() && line[pos] >= '0' && line[pos] <= '9')
+        {
+            if (value < 1000000) // Saturate instead of overflowing, anything this big is out of range anyway
+                value = value * 10 + (line[pos] - '0');
+            pos++;
+        }
+        values[count++] = value;
+    }
+}
+
+// Read one line of input and parse up to maxCount whole numbers from it into values.
+// Returns how many numbers were found, 0 if the line held anything else, or -1 once input has ended.
+int readNumbers(int *values, int maxCount)
+{
+    static string line; // Reused for every line so reading input does not allocate
+    if (!getline(cin, line))
+        return -1;
+    return parseNumbers(line, 0, values, maxCount);
+}
+
+// Read a single number from a line of input; anything else reads as -1.
+// Returns false once input has ended.
+bool readNumber(int &value)
+{
+    int count = readNumbers(&value, 1);
+    if (count == 0)
+        value = -1;
+    return count >= 0;
+}
+
+// Characters for values in puzzle lines: '.' for empty, then 1-9, A-Z for 10-35, a-z for 36-61 and
+// @ # $ for 62-64
+const char VALUE_CHARS[] = ".123456789ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz@#$";
+
+// Character for value in puzzle lines
+inline char valueChar(int value)
+{
+    return VALUE_CHARS[value];
+}
+
+// Value of a puzzle line character, 0 for '.' or '0', or -1 if c is not a value of this board size.
+// Up to 35x35, lower case letters read the same as upper case.
+inline int charValue(char c)
+{
+    if (N <= 35 && c >= 'a' && c <= 'z')
+        c = static_cast<char>(c - 'a' + 'A');
+    for (int value = 0; value <= N; value++)
+    {
+        if (VALUE_CHARS[value] == c)
+            return value;
+    }
+    return c == '0' ? 0 : -1;
+}
+
+// Read a puzzle line from text, starting at pos, into grid: N*N values in row order, blanks allowed
+// between them. Returns false if the line holds anything else, or more or fewer cells.
+bool parseGrid(const string &text, Grid &grid, size_t pos = 0)
+{
+    int cells = 0;
+    for (; pos < text.size(); pos++)
+    {
+        char c = text[pos];
+        if (c == ' ' || c == '\t' || c == '\r')
+            continue;
+        int value = charValue(c);
+        if (value < 0 || cells == N * N)
+            return false;
+        grid[cells / N][cells % N] = value;
+        cells++;
+    }
+    return cells == N * N;
+}
+
+// Index of the mini box holding cell (i, j)
+inline int boxIndex(int i, int j)
+{
+    return (i / MINI_BOX_SIZE) * MINI_BOX_SIZE + j / MINI_BOX_SIZE;
+}
+
+// Cell (i, j) that is the k-th cell of unit: rows come first, then columns, then boxes
+inline void unitCell(int unit, int k, int &i, int &j)
+{
+    if (unit < N)
+    {
+        i = unit;
+        j = k;
+    }
+    else if (unit < 2 * N)
+    {
+        i = k;
+        j = unit - N;
+    }
+    else
+    {
+        i = (unit - 2 * N) / MINI_BOX_SIZE * MINI_BOX_SIZE + k / MINI_BOX_SIZE;
+        j = (unit - 2 * N) % MINI_BOX_SIZE * MINI_BOX_SIZE + k % MINI_BOX_SIZE;
+    }
+}
+
+// Number of set bits in x
+inline int countBits(unsigned int x)
+{
+    x = x - ((x >> 1) & 0x55555555u);
+    x = (x & 0x33333333u) + ((x >> 2) & 0x33333333u);
+    x = (x + (x >> 4)) & 0x0F0F0F0Fu;
+    return static_cast<int>((x * 0x01010101u) >> 24);
+}
+
+// Number of set bits in x, for the 64-bit masks of boards past 32x32
+inline int countBits(unsigned long long x)
+{
+    x = x - ((x >> 1) & 0x5555555555555555ull);
+    x = (x & 0x3333333333333333ull) + ((x >> 2) & 0x3333333333333333ull);
+    x = (x + (x >> 4)) & 0x0F0F0F0F0F0F0F0Full;
+    return static_cast<int>((x * 0x0101010101010101ull) >> 56);
+}
+
+// Mask bit of digit num
+inline Mask digitBit(int num)
+{
+    return Mask(1) << (num - 1);
+}
+
+// Smallest digit in a non-empty mask
+inline int lowestDigit(Mask mask)
+{
+    return countBits((mask & (0 - mask)) - 1) + 1;
+}
+
+// Largest digit in a non-empty mask
+inline int highestDigit(Mask mask)
+{
+    for (int shift = 1; shift < N; shift *= 2)
+        mask |= mask >> shift;
+    return countBits(mask);
+}
+
+// Digits from lo to hi, both included, clamped to 1..N
+inline Mask digitRange(int lo, int hi)
+{
+    lo = max(lo, 1);
+    hi = min(hi, N);
+    if (lo > hi)
+        return 0;
+    return (ALL_CANDIDATES >> (N - hi)) & ~(digitBit(lo) - 1);
+}
+
+// Greatest common divisor, usable in constant expressions
+constexpr ArchiveState gcdOf(ArchiveState a, ArchiveState b)
+{
+    return b == 0 ? a : gcdOf(b, a % b);
+}
+
+// Least common multiple of acc and every number from k to n
+constexpr ArchiveState lcmUpTo(ArchiveState acc, ArchiveState k, ArchiveState n)
+{
+    return k > n ? acc : lcmUpTo(acc / gcdOf(acc, k) * k, k + 1, n);
+}
+
+// Lowest archive coder state, a multiple of every possible radix so renormalization stays exact
+constexpr ArchiveState ARCHIVE_STATE_LOW = lcmUpTo(1, 1, N);
+
+// Sum of the count smallest digits in mask, or -1 if it holds fewer
+inline int sumLowest(Mask mask, int count)
+{
+    int sum = 0;
+    for (; count > 0; count--, mask &= mask - 1)
+    {
+        if (mask == 0)
+            return -1;
+        sum += lowestDigit(mask);
+    }
+    return sum;
+}
+
+// Sum of the count largest digits in mask, or -1 if it holds fewer
+inline int sumHighest(Mask mask, int count)
+{
+    int sum = 0;
+    for (; count > 0; count--)
+    {
+        if (mask == 0)
+            return -1;
+        int digit = highestDigit(mask);
+        sum += digit;
+        mask &= ~digitBit(digit);
+    }
+    return sum;
+}
+
+// Whether count distinct digits from mask can add up to sum. Branches on the largest digit and cuts
+// off every branch whose bounds miss sum, so it stays cheap on the masks a sandwich produces.
+bool distinctSumReachable(Mask mask, int count, int sum)
+{
+    int lowest = sumLowest(mask, count);
+    if (lowest < 0 || sum < lowest || sum > sumHighest(mask, count))
+        return false;
+    if (count == 0 || sum == lowest)
+        return true;
+    int digit = highestDigit(mask);
+    mask &= ~digitBit(digit);
+    return distinctSumReachable(mask, count - 1, sum - digit) || distinctSumReachable(mask, count, sum);
+}
+
+// A variant constraint on top of the units. cells holds cell indexes (i * N + j) in path order,
+// with the bulb or circle first; a sandwich holds the N cells of its row or column. No constraint
+// has more than N + 1 cells.
+struct Constraint
+{
+    int kind; // CONSTRAINT_*
+    int sum;  // The sandwich clue
+    vector<int> cells;
+};
+
+// Narrow dom, the candidates of each cell of c in order, by bounds reasoning on c alone.
+// Returns false once some cell is left with none.
+bool narrowConstraint(const Constraint &c, Mask *dom)
+{
+    int count = static_cast<int>(c.cells.size());
+    for (int k = 0; k < count; k++)
+    {
+        if (dom[k] == 0)
+            return false;
+    }
+
+    if (c.kind == CONSTRAINT_THERMO)
+    {
+        // Each cell lies above the smallest option of the one before and below the largest of the one after
+        for (int k = 1; k < count; k++)
+        {
+            dom[k] &= digitRange(lowestDigit(dom[k - 1]) + 1, N);
+            if (dom[k] == 0)
+                return false;
+        }
+        for (int k = count - 2; k >= 0; k--)
+        {
+            dom[k] &= digitRange(1, highestDigit(dom[k + 1]) - 1);
+            if (dom[k] == 0)
+                return false;
+        }
+        return true;
+    }
+
+    if (c.kind == CONSTRAINT_ARROW)
+    {
+        // The circle lies within the bounds of the path sum, and each path cell within what the
+        // circle leaves once the other path cells take their extremes
+        int minSum = 0, maxSum = 0;
+        int low[N + 1], high[N + 1];
+        for (int k = 1; k < count; k++)
+        {
+            low[k] = lowestDigit(dom[k]);
+            high[k] = highestDigit(dom[k]);
+            minSum += low[k];
+            maxSum += high[k];
+        }
+        dom[0] &= digitRange(minSum, maxSum);
+        if (dom[0] == 0)
+            return false;
+        int circleLow = lowestDigit(dom[0]), circleHigh = highestDigit(dom[0]);
+        for (int k = 1; k < count; k++)
+        {
+            dom[k] &= digitRange(circleLow - (maxSum - high[k]), circleHigh - (minSum - low[k]));
+            if (dom[k] == 0)
+                return false;
+        }
+        return true;
+    }
+
+    // Sandwich: the 1 and the N must sit at the ends of a stretch whose cells can reach the clue,
+    // judging by their own bounds and by whether that many distinct digits from their candidates can
+    // add up to it. Each cell keeps the digits it can take in at least one such stretch.
+    Mask ends = digitBit(1) | digitBit(N);
+    int low[N + 1], high[N + 1], blocked[N + 1]; // Prefix sums over the cells, blocked counts cells with no inner digit
+    low[0] = high[0] = blocked[0] = 0;
+    for (int k = 0; k < N; k++)
+    {
+        Mask inner = dom[k] & ~ends;
+        low[k + 1] = low[k] + (inner != 0 ? lowestDigit(inner) : 0);
+        high[k + 1] = high[k] + (inner != 0 ? highestDigit(inner) : 0);
+        blocked[k + 1] = blocked[k] + (inner == 0 ? 1 : 0);
+    }
+    Mask keep[N] = {};
+    int lastStart = -1, firstEnd = N; // Cells before lastStart or after firstEnd lie outside some stretch
+    for (int a = 0; a < N; a++)
+    {
+        Mask inner = 0; // Candidates of the cells between a and b
+        for (int b = a + 1; b < N; inner |= dom[b++] & ~ends)
+        {
+            bool oneFirst = (dom[a] & digitBit(1)) && (dom[b] & digitBit(N));
+            bool topFirst = (dom[a] & digitBit(N)) && (dom[b] & digitBit(1));
+            int between = b - a - 1;
+            if ((!oneFirst && !topFirst) || blocked[b] - blocked[a + 1] != 0)
+                continue;
+            int minSum = low[b] - low[a + 1], maxSum = high[b] - high[a + 1];
+            if (c.sum < minSum || c.sum > maxSum || !distinctSumReachable(inner, between, c.sum))
+                continue;
+            keep[a] |= (oneFirst ? digitBit(1) : 0) | (topFirst ? digitBit(N) : 0);
+            keep[b] |= (oneFirst ? digitBit(N) : 0) | (topFirst ? digitBit(1) : 0);
+            int restLow = sumLowest(inner, between - 1), restHigh = sumHighest(inner, between - 1);
+            for (int t = a + 1; t < b; t++)
+            {
+                int tLow = low[t + 1] - low[t], tHigh = high[t + 1] - high[t];
+                keep[t] |= digitRange(c.sum - min(maxSum - tHigh, restHigh), c.sum - max(minSum - tLow, restLow)) & ~ends;
+            }
+            lastStart = max(lastStart, a);
+            firstEnd = min(firstEnd, b);
+        }
+    }
+    if (lastStart < 0)
+        return false;
+    for (int k = 0; k < N; k++)
+    {
+        if (k < lastStart || k > firstEnd)
+            keep[k] |= ~ends;
+        dom[k] &= keep[k];
+        if (dom[k] == 0)
+            return false;
+    }
+    return true;
+}
+
 class SudokuBoard
 {
 public:
     SudokuBoard()
     {
-        solved.resize(N, vector<int>(N, 0));
-        unsolved.resize(N, vector<int>(N, 0));
+        solved = {};
+        unsolved = {};
         emptyCells = 0;
+
+        // Each board owns its random engine, seeded once, so boards never share generator state
+        random_device device;
+        rng.seed(device() ^ static_cast<unsigned int>(time(0)));
+
+        for (int r = 1; r <= N; r++)
+        {
+            reciprocal[r] = ((1ULL << 32) + r - 1) / r;
+        }
+        for (int byte = 0; byte < 256; byte++)
+        {
+            byteCount[byte] = static_cast<unsigned char>(countBits(static_cast<unsigned int>(byte)));
+            int rank = 0;
+            for (int bit = 0; bit < 8; bit++)
+            {
+                byteSelect[byte][bit] = 0;
+                if (byte & (1 << bit))
+                    byteSelect[byte][rank++] = static_cast<unsigned char>(bit);
+            }
+        }
+
+        solveNodes = 0;
+        nodeBudget = numeric_limits<long long>::max();
+        branching = BRANCH_HIDDEN_SINGLE;
+        trialPruning = false;
+        randomOrder = false;
+        trialCost = 0;
+        trailSize = 0;
+        variantConstraints = 0;
+        for (int cell = 0; cell < N * N; cell++)
+            allowed[cell] = ALL_CANDIDATES;
     }
 
     int emptyCells;
 
-    vector<vector<int>> solved;
-    vector<vector<int>> unsolved;
+    mt19937 rng;
+
+    string frame; // Reused output buffer for printSudoku
+
+    // reciprocal[r] is 2^32 / r rounded up, so (x * reciprocal[r]) >> 32 == x / r whenever x * r < 2^32
+    unsigned long long reciprocal[N + 1];
+    // byteCount[b] is the number of set bits in byte b, byteSelect[b][k] the position of its k-th one
+    unsigned char byteCount[256];
+    unsigned char byteSelect[256][8];
+
+    Grid solved;
+    Grid unsolved;
+
+    // Solver state: the grid being searched and the digits used in each row, column and box
+    Grid work;
+    Mask rowMask[N], colMask[N], boxMask[N];
+    unsigned char places[3 * N][N + 1]; // Scratch for branchSolutions: places left per unit and digit
+    long long solveNodes; // Search nodes visited by the last countSolutions call
+    long long nodeBudget; // Search nodes allowed per call before giving up
+    int branching;        // BRANCH_* strategy used by searchSolutions
+    bool trialPruning;    // Run trial propagation at every search node
+    bool randomOrder;     // Try the options of each branch starting from a random one
+    long long trialCost;  // Tentative placements made by trialPropagation
+
+    // Placements that can be undone, as cell indexes in the order they were made
+    int trail[N * N];
+    int trailSize;
+
+    vector<Grid> repairSolutions; // Reused by repairPuzzle
+
+    // State of fillSearch: places left for every digit in every unit (rows, then columns, then boxes),
+    // and the forced moves still to check, as cells or as N * N + unit * (N + 1) + digit
+    unsigned char fillPlaces[3 * N][N + 1];
+    vector<int> fillQueue;
+
+    // Variant constraints, and for every cell the indexes of the constraints through it and of those
+    // through it or a cell sharing a unit with it, whose candidates a placement there changes
+    vector<Constraint> constraints;
+    vector<int> cellConstraints[N * N];
+    vector<int> peerConstraints[N * N];
+    int variantConstraints; // Thermometers, arrows and sandwich clues each that fillValues adds
+
+    // Solver state for constraints: the candidates they still allow in each cell, the narrowings made
+    // as (cell, previous mask) so they can be undone, and the queue of constraints to re-run
+    Mask allowed[N * N];
+    vector<pair<int, Mask>> narrowed;
+    vector<int> dirty;
+    vector<char> queued;
 
     // Random number generator
     int randomGenerator(int num)
     {
         // num is the max limit of generated number
-        return (rand() % num) + 1;
+        return uniform_int_distribution<int>(1, num)(rng);
     }
 
     // Check if it is safe to put the number in a specific cell
@@ -45,7 +529,106 @@ public:
     {
         // first check the row, then check the column
         // then check the mini box
-        return (isAbsentInRow(i, num) && isAbsentInCol(j, num) && isAbsentInBox(i - i % MINI_BOX_SIZE, j - j % MINI_BOX_SIZE, num));
+        // and finally the variant constraints through the cell
+        return (isAbsentInRow(i, num) && isAbsentInCol(j, num) && isAbsentInBox(i - i % MINI_BOX_SIZE, j - j % MINI_BOX_SIZE, num) &&
+                constraintsAllow(i, j, num));
+    }
+
+    // Check that num in cell (i, j) leaves every constraint through the cell satisfiable, judging by
+    // the digits already on the board; empty cells may still take any digit
+    bool constraintsAllow(int i, int j, int num)
+    {
+        Mask dom[N + 1];
+        const vector<int> &through = cellConstraints[i * N + j];
+        for (size_t t = 0; t < through.size(); t++)
+        {
+            const Constraint &c = constraints[through[t]];
+            for (size_t k = 0; k < c.cells.size(); k++)
+            {
+                int cell = c.cells[k];
+                int value = cell == i * N + j ? num : unsolved[cell / N][cell % N];
+                dom[k] = value != 0 ? digitBit(value) : ALL_CANDIDATES;
+            }
+            if (!narrowConstraint(c, dom))
+                return false;
+        }
+        return true;
+    }
+
+    // Add a constraint and register it with its cells and their peers
+    void addConstraint(const Constraint &c)
+    {
+        int index = static_cast<int>(constraints.size());
+        for (size_t k = 0; k < c.cells.size(); k++)
+        {
+            cellConstraints[c.cells[k]].push_back(index);
+            forEachPeer(c.cells[k], [&](int peer) {
+                if (peerConstraints[peer].empty() || peerConstraints[peer].back() != index)
+                    peerConstraints[peer].push_back(index);
+            });
+        }
+        constraints.push_back(c);
+        queued.push_back(0);
+    }
+
+    // Take back the last addConstraint
+    void removeLastConstraint()
+    {
+        const Constraint &c = constraints.back();
+        int index = static_cast<int>(constraints.size()) - 1;
+        for (size_t k = 0; k < c.cells.size(); k++)
+        {
+            cellConstraints[c.cells[k]].pop_back();
+            forEachPeer(c.cells[k], [&](int peer) {
+                if (!peerConstraints[peer].empty() && peerConstraints[peer].back() == index)
+                    peerConstraints[peer].pop_back();
+            });
+        }
+        constraints.pop_back();
+        queued.pop_back();
+        dirty.clear();
+    }
+
+    // Call visit for cell and for every cell sharing its row, column or box; box cells in the same row
+    // or column come up twice
+    template <typename Visit>
+    static void forEachPeer(int cell, Visit visit)
+    {
+        int i = cell / N, j = cell % N;
+        int rowStart = i - i % MINI_BOX_SIZE, colStart = j - j % MINI_BOX_SIZE;
+        for (int k = 0; k < N; k++)
+        {
+            visit(i * N + k);
+            visit(k * N + j);
+            visit((rowStart + k / MINI_BOX_SIZE) * N + colStart + k % MINI_BOX_SIZE);
+        }
+    }
+
+    // Drop every constraint
+    void clearConstraints()
+    {
+        while (!constraints.empty())
+            removeLastConstraint();
+    }
+
+    // Append the constraints as "<kind> <cells>" items separated by commas: thermometers and arrows
+    // list their cells as r<row>c<col> from the bulb or circle on, sandwiches read "row|col <k> <sum>"
+    void appendConstraints(string &out)
+    {
+        for (size_t t = 0; t < constraints.size(); t++)
+        {
+            const Constraint &c = constraints[t];
+            out += t == 0 ? " " : ", ";
+            if (c.kind == CONSTRAINT_SANDWICH)
+            {
+                bool row = c.cells[0] / N == c.cells[1] / N;
+                out += "sandwich " + string(row ? "row " : "col ") + to_string((row ? c.cells[0] / N : c.cells[0] % N) + 1) + " " + to_string(c.sum);
+                continue;
+            }
+            out += c.kind == CONSTRAINT_THERMO ? "thermo" : "arrow";
+            for (size_t k = 0; k < c.cells.size(); k++)
+                out += " r" + to_string(c.cells[k] / N + 1) + "c" + to_string(c.cells[k] % N + 1);
+        }
     }
 
     // Check if the number is absent in the 3x3 box
@@ -95,14 +678,46 @@ public:
     {
         // To improve the efficiency we would fill the diagonal mini boxes first
 
-        fillDiagonal();                  // Fill the diagonal MINI_BOX_SIZE x MINI_BOX_SIZE matrices
-        fillRemaining(0, MINI_BOX_SIZE); // Fill remaining blocks
+        clearConstraints(); // A new grid makes the old constraints meaningless
+        fillGrid(); // Fill the diagonal MINI_BOX_SIZE x MINI_BOX_SIZE matrices, then the remaining blocks
 
         // Copy the unsolved board to solved
         solved = unsolved;
 
+        // Variant puzzles read their constraints off the solution, so it always satisfies them
+        if (variantConstraints > 0)
+            addRandomConstraints(variantConstraints);
+
         // unsolved board is fully filled now, create empty cells in the board
         addEmptyCells(); // Remove the K no. of digits from the board
+
+        // Random holes can leave several solutions, and the player would be told a valid one is wrong
+        emptyCells -= repairPuzzle(unsolved, solved, REPAIR_NODE_BUDGET);
+    }
+
+    // Clear unsolved and fill it with a complete grid. The diagonal boxes are independent, so they
+    // are seeded at random, and fillSearch completes the rest, trying candidates in random order.
+    // Its search time has a heavy tail, so after FILL_NODE_BUDGET nodes it reseeds and starts over.
+    // Variant constraints play no part here. Returns the number of restarts.
+    int fillGrid()
+    {
+        nodeBudget = FILL_NODE_BUDGET;
+        int restarts = 0;
+        while (true)
+        {
+            resetBoard();
+            fillDiagonal();
+            if (startSearch(unsolved))
+            {
+                fillStart();
+                if (fillSearch())
+                    break;
+            }
+            restarts++;
+        }
+        unsolved = work;
+        nodeBudget = numeric_limits<long long>::max();
+        return restarts;
     }
 
     // Fill the diagonal MINI_BOX_SIZE number of MINI_BOX_SIZE x MINI_BOX_SIZE matrices
@@ -131,58 +746,91 @@ public:
         }
     }
 
-    // Fill the remaining cells recursively
-    bool fillRemaining(int i, int j)
+    // Add count thermometers, count arrows and count sandwich clues that solved satisfies. The
+    // thermometers and arrows do not share cells, and the sandwiches take different lines.
+    void addRandomConstraints(int count)
     {
-        if (j >= N && i < N - 1)
+        vector<char> used(N * N, 0);
+        Constraint c;
+        for (int kind = CONSTRAINT_THERMO; kind <= CONSTRAINT_ARROW; kind++)
         {
-            i++;
-            j = 0;
-        }
-        if (i >= N && j >= N)
-        {
-            return true;
-        }
-        if (i < MINI_BOX_SIZE)
-        {
-            if (j < MINI_BOX_SIZE)
+            for (int made = 0, tries = 0; made < count && tries < VARIANT_TRIES * count; tries++)
             {
-                j = MINI_BOX_SIZE;
+                if (!growPath(kind, used, c))
+                    continue;
+                for (size_t k = 0; k < c.cells.size(); k++)
+                    used[c.cells[k]] = 1;
+                addConstraint(c);
+                made++;
             }
         }
-        else if (i < N - MINI_BOX_SIZE)
+
+        vector<char> lineUsed(2 * N, 0);
+        for (int made = 0; made < count && made < 2 * N; made++)
         {
-            if (j == (i / MINI_BOX_SIZE) * MINI_BOX_SIZE)
+            int line;
+            do
             {
-                j += MINI_BOX_SIZE;
-            }
-        }
-        else
-        {
-            if (j == N - MINI_BOX_SIZE)
+                line = randomGenerator(2 * N) - 1;
+            } while (lineUsed[line]);
+            lineUsed[line] = 1;
+
+            c.kind = CONSTRAINT_SANDWICH;
+            c.sum = 0;
+            c.cells.clear();
+            bool inside = false;
+            for (int k = 0; k < N; k++)
             {
-                i++;
-                j = 0;
-                if (i >= N)
-                {
-                    return true;
-                }
+                int cell = line < N ? line * N + k : k * N + line - N;
+                int value = solved[cell / N][cell % N];
+                c.cells.push_back(cell);
+                if (value == 1 || value == N)
+                    inside = !inside;
+                else if (inside)
+                    c.sum += value;
             }
+            addConstraint(c);
         }
+    }
 
-        for (int num = 1; num <= N; num++)
+    // Walk a thermometer (digits increasing along the path) or an arrow (a circle, then a path whose
+    // digits add up to it) through solved, from a random cell by random steps to neighbouring cells,
+    // diagonals included, that are not used yet. Returns false if the walk gets stuck.
+    bool growPath(int kind, const vector<char> &used, Constraint &c)
+    {
+        c.kind = kind;
+        c.sum = 0;
+        c.cells.clear();
+        int start = randomGenerator(N * N) - 1;
+        if (used[start])
+            return false;
+        c.cells.push_back(start);
+        size_t length = 2 + randomGenerator(MINI_BOX_SIZE); // Thermometers take 3 to MINI_BOX_SIZE + 2 cells
+        int left = solved[start / N][start % N];            // What the arrow path still has to add up to
+        while (kind == CONSTRAINT_THERMO ? c.cells.size() < length : left > 0)
         {
-            if (checkIfSafe(i, j, num))
+            int last = c.cells.back();
+            int options[8];
+            int count = 0;
+            for (int di = -1; di <= 1; di++)
             {
-                unsolved[i][j] = num;
-                if (fillRemaining(i, j + 1))
+                for (int dj = -1; dj <= 1; dj++)
                 {
-                    return true;
+                    int i = last / N + di, j = last % N + dj;
+                    if (i < 0 || i >= N || j < 0 || j >= N || used[i * N + j] || find(c.cells.begin(), c.cells.end(), i * N + j) != c.cells.end())
+                        continue;
+                    int value = solved[i][j];
+                    if (kind == CONSTRAINT_THERMO ? value > solved[last / N][last % N] : value <= left)
+                        options[count++] = i * N + j;
                 }
-                unsolved[i][j] = 0;
             }
+            if (count == 0)
+                return false;
+            int next = options[randomGenerator(count) - 1];
+            c.cells.push_back(next);
+            left -= solved[next / N][next % N];
         }
-        return false;
+        return c.cells.size() >= 3;
     }
 
     // Remove some digits from the board to create empty cells
@@ -206,44 +854,58 @@ public:
     // Print Sudoku board
     void printSudoku()
     {
-        cout << "  X";
+        // Values and row numbers are padded to two digits on boards bigger than 9x9
+        const int width = N > 9 ? 2 : 1;
+
+        // Build the whole frame in one buffer and write it once instead of flushing line by line
+        frame.clear();
+        frame += string(width, ' ') + " X";
         for (int i = 1; i <= N; i++)
         {
-            cout << " " << i << " ";
+            appendPadded(i, width);
             if (i % MINI_BOX_SIZE == 0)
-                cout << " ";
+                frame += " ";
         }
-        cout << endl;
-        cout << "Y  ";
-        for (int k = 0; k < N + 2 * MINI_BOX_SIZE; k++)
+        frame += "\n";
+        frame += "Y" + string(width + 1, ' ');
+        for (int k = 0; k < N + 2 * MINI_BOX_SIZE + (width - 1) * N / 2; k++)
         {
-            cout << "--";
+            frame += "--";
         }
-        cout << endl;
+        frame += "\n";
 
         for (int i = 0; i < N; i++)
         {
-            cout << (i + 1) << " ";
+            string label = to_string(i + 1);
+            frame += string(width - label.size(), ' ') + label + " ";
             for (int j = 0; j < N; j++)
             {
                 if (j % MINI_BOX_SIZE == 0)
-                    cout << "|";
+                    frame += "|";
                 if (unsolved[i][j] == 0)
-                    cout << " . ";
+                    frame += string(width, ' ') + ". ";
                 else
-                    cout << " " << unsolved[i][j] << " ";
+                    appendPadded(unsolved[i][j], width);
             }
-            cout << "|" << endl;
+            frame += "|\n";
             if ((i + 1) % MINI_BOX_SIZE == 0)
             {
-                cout << "   ";
-                for (int k = 0; k < N + 2 * MINI_BOX_SIZE; k++)
+                frame += string(width + 2, ' ');
+                for (int k = 0; k < N + 2 * MINI_BOX_SIZE + (width - 1) * N / 2; k++)
                 {
-                    cout << "--";
+                    frame += "--";
                 }
-                cout << endl;
+                frame += "\n";
             }
         }
+        cout << frame;
+    }
+
+    // Append value to frame right-aligned in width characters, with a space on each side
+    void appendPadded(int value, int width)
+    {
+        string number = to_string(value);
+        frame += " " + string(width - number.size(), ' ') + number + " ";
     }
 
     // Check if the board is solved
@@ -262,44 +924,2247 @@ public:
         return true;
     }
 
-    // Reset the board to all 0s
-    void resetBoard()
+    // Pack the puzzle for archiving and return the bytes written to out.
+    // Each solution digit is coded as its index among the candidates left by the earlier cells,
+    // so later cells need fewer bits (forced cells take none). The digits go through a byte-wise
+    // range coder (rANS with uniform symbols) and the clue mask follows as one bit per cell.
+    int encodePuzzle(unsigned char *out)
     {
-        for (int i = 0; i < N; i++)
+        int radix[N * N];
+        int digit[N * N];
+        Mask rowUsed[N] = {}, colUsed[N] = {}, boxUsed[N] = {};
+        for (int cell = 0; cell < N * N; cell++)
         {
-            for (int j = 0; j < N; j++)
+            int i = cell / N;
+            int j = cell % N;
+            int box = boxIndex(i, j);
+            Mask used = rowUsed[i] | colUsed[j] | boxUsed[box];
+            radix[cell] = 0;
+            digit[cell] = 0;
+            for (int num = 1; num <= N; num++)
             {
-                unsolved[i][j] = 0;
+                if (used & digitBit(num))
+                    continue;
+                if (num < solved[i][j])
+                    digit[cell]++;
+                radix[cell]++;
             }
+            rowUsed[i] |= digitBit(solved[i][j]);
+            colUsed[j] |= digitBit(solved[i][j]);
+            boxUsed[box] |= digitBit(solved[i][j]);
         }
-    }
-};
 
-void howToPlay()
-{
-    clearScreen();
-    cout << "==== How to Play ====\n\n";
-    cout << "Sudoku is a logic-based, combinatorial number-placement puzzle.\n\n";
-    cout << "The objective is to fill a 9x9 grid with digits so that each column, each row, and each of the nine 3x3 subgrids that compose the grid contain all of the digits from 1 to 9.\n\n";
-    cout << "The puzzle setter provides a partially completed grid, which for a well-posed puzzle has a single solution.\n";
-    cout << "Completed puzzles are always a type of Latin square with an additional constraint on the contents of individual regions.\n\n";
-    cout << "For more information, visit: https://en.wikipedia.org/wiki/Sudoku \n\n";
-    system("pause");
-}
+        // The coder is last-in first-out, so encode backwards and emit the bytes reversed
+        unsigned char stream[N * N];
+        int count = 0;
+        ArchiveState state = ARCHIVE_STATE_LOW;
+        for (int cell = N * N - 1; cell >= 0; cell--)
+        {
+            if (radix[cell] <= 1)
+                continue;
+            ArchiveState limit = (ARCHIVE_STATE_LOW / radix[cell]) << 8;
+            while (state >= limit)
+            {
+                stream[count++] = static_cast<unsigned char>(state);
+                state >>= 8;
+            }
+            state = state * radix[cell] + digit[cell];
+        }
 
-void aboutDevelopers()
-{
-    clearScreen();
-    cout << "==== About Developers ====\n\n";
-    cout << "Developed by: \n";
-    cout << "1. SR Tamim - ID: 41230201087\n";
-    cout << "2. Mahatab Hossain - ID: 41230201189\n";
-    cout << "3. Tousif Mahabub - ID: 41230201026\n";
-    system("pause");
-}
+        int pos = 0;
+        do
+        {
+            out[pos++] = static_cast<unsigned char>((state & 0x7F) | (state > 0x7F ? 0x80 : 0));
+            state >>= 7;
+        } while (state != 0);
+        while (count > 0)
+        {
+            out[pos++] = stream[--count];
+        }
+
+        for (int k = 0; k < (N * N + 7) / 8; k++)
+        {
+            out[pos + k] = 0;
+        }
+        for (int cell = 0; cell < N * N; cell++)
+        {
+            if (unsolved[cell / N][cell % N] != 0)
+                out[pos + cell / 8] |= 1 << (cell % 8);
+        }
+        return pos + (N * N + 7) / 8;
+    }
+
+    // Unpack a puzzle written by encodePuzzle from the available bytes at in and return the bytes read,
+    // or -1 if the record is corrupt or runs past them. The coder state has to start in its normal range
+    // and end where the encoder started it, which catches most damage. in must be readable for
+    // ARCHIVE_RECORD_MAX bytes even past available.
+    int decodePuzzle(const unsigned char *in, size_t available)
+    {
+        int pos = 0;
+        ArchiveState state = 0;
+        for (int shift = 0;; shift += 7)
+        {
+            if (shift >= static_cast<int>(8 * sizeof(ArchiveState)))
+                return -1;
+            state |= static_cast<ArchiveState>(in[pos] & 0x7F) << shift;
+            if ((in[pos++] & 0x80) == 0)
+                break;
+        }
+        if (state < ARCHIVE_STATE_LOW || state / 256 >= ARCHIVE_STATE_LOW)
+            return -1;
+
+        Mask rowUsed[N] = {}, colUsed[N] = {}, boxUsed[N] = {};
+        for (int i = 0; i < N; i++)
+        {
+            for (int j = 0; j < N; j++)
+            {
+                int box = boxIndex(i, j);
+                Mask free = ~(rowUsed[i] | colUsed[j] | boxUsed[box]) & ALL_CANDIDATES;
+                unsigned int counts[(N + 7) / 8]; // Candidates in each byte of free
+                int radix = 0;
+                for (int b = 0; b < (N + 7) / 8; b++)
+                {
+                    counts[b] = byteCount[static_cast<unsigned int>(free >> (8 * b)) & 0xFF];
+                    radix += counts[b];
+                }
+                if (radix == 0)
+                    return -1; // Earlier digits were corrupt and boxed this cell in
+
+                // Divide through the reciprocal table while the state is small enough for it to be
+                // exact. Forced cells (radix 1) take digit 0 and read nothing.
+                ArchiveState quotient;
+                if (ARCHIVE_STATE_LOW * 256 * N < (1ULL << 32))
+                    quotient = (state * reciprocal[radix]) >> 32;
+                else
+                    quotient = state / radix;
+                unsigned int digit = static_cast<unsigned int>(state - quotient * radix);
+
+                // Take the digit-th candidate from the byte it falls in. Each cell sits on one long
+                // dependency chain, and a data-dependent branch here or below costs a misprediction
+                // on most cells, so both are done with masks instead.
+                int num = 0;
+                for (int b = 0; b < (N + 7) / 8; b++)
+                {
+                    unsigned int hit = (digit < counts[b] ? 1u : 0u) & (num == 0 ? 1u : 0u);
+                    num |= (8 * b + 1 + byteSelect[static_cast<unsigned int>(free >> (8 * b)) & 0xFF][digit & 7]) & (0u - hit);
+                    digit -= counts[b] & (hit - 1);
+                }
+
+                // A radix never exceeds 256, so one byte always brings the state back into range
+                int refill = quotient < ARCHIVE_STATE_LOW ? 1 : 0;
+                state = (quotient << (8 * refill)) | (in[pos] & (0 - refill));
+                pos += refill;
+
+                Mask bit = digitBit(num);
+                solved[i][j] = num;
+                rowUsed[i] |= bit;
+                colUsed[j] |= bit;
+                boxUsed[box] |= bit;
+            }
+        }
+
+        if (state != ARCHIVE_STATE_LOW || pos + (N * N + 7) / 8 > static_cast<long long>(available))
+            return -1;
+
+        emptyCells = N * N;
+        for (int cell = 0; cell < N * N; cell++)
+        {
+            int given = (in[pos + cell / 8] >> (cell % 8)) & 1;
+            unsolved[cell / N][cell % N] = solved[cell / N][cell % N] & (0 - given);
+            emptyCells -= given;
+        }
+        return pos + (N * N + 7) / 8;
+    }
+
+    // Count the solutions of grid, stopping once limit are found.
+    // The first solution found is copied into solution.
+    int countSolutions(const Grid &grid, int limit, Grid &solution)
+    {
+        if (!startSearch(grid))
+            return 0;
+        return searchSolutions(limit, &solution, nullptr);
+    }
+
+    // Append up to limit solutions of grid to solutions and return how many were found
+    int enumerateSolutions(const Grid &grid, int limit, vector<Grid> &solutions)
+    {
+        if (!startSearch(grid))
+            return 0;
+        return searchSolutions(limit, nullptr, &solutions);
+    }
+
+    // Load grid into the solver state, returns false if its givens already clash
+    bool startSearch(const Grid &grid)
+    {
+        solveNodes = 0;
+        trailSize = 0;
+        work = grid;
+        for (int cell = 0; cell < N * N; cell++)
+            allowed[cell] = ALL_CANDIDATES;
+        narrowed.clear();
+        dirty.clear();
+        for (size_t t = 0; t < constraints.size(); t++)
+        {
+            queued[t] = 1;
+            dirty.push_back(static_cast<int>(t));
+        }
+        for (int k = 0; k < N; k++)
+        {
+            rowMask[k] = colMask[k] = boxMask[k] = 0;
+        }
+        for (int i = 0; i < N; i++)
+        {
+            for (int j = 0; j < N; j++)
+            {
+                if (work[i][j] == 0)
+                    continue;
+                Mask bit = digitBit(work[i][j]);
+                if ((rowMask[i] | colMask[j] | boxMask[boxIndex(i, j)]) & bit)
+                    return false;
+                rowMask[i] |= bit;
+                colMask[j] |= bit;
+                boxMask[boxIndex(i, j)] |= bit;
+            }
+        }
+        return true;
+    }
+
+    // Reduce the givens of a puzzle with no solution to a minimal subset that is still contradictory:
+    // drop each given in turn and put it back only if the rest becomes solvable. Checks that run past
+    // EXPLAIN_NODE_BUDGET count as solvable, which keeps the result contradictory and bounds the time.
+    void explainContradiction(Grid &puzzle)
+    {
+        Grid ignored;
+        nodeBudget = EXPLAIN_NODE_BUDGET;
+        for (int cell = 0; cell < N * N; cell++)
+        {
+            int i = cell / N;
+            int j = cell % N;
+            int value = puzzle[i][j];
+            if (value == 0)
+                continue;
+            puzzle[i][j] = 0;
+            if (countSolutions(puzzle, 1, ignored) != 0)
+                puzzle[i][j] = value;
+        }
+        nodeBudget = numeric_limits<long long>::max();
+    }
+
+    // Append the givens of grid as "r<row>c<col>=<value>" items separated by spaces
+    static void appendGivens(string &out, const Grid &grid)
+    {
+        for (int i = 0; i < N; i++)
+        {
+            for (int j = 0; j < N; j++)
+            {
+                if (grid[i][j] != 0)
+                    out += " r" + to_string(i + 1) + "c" + to_string(j + 1) + "=" + to_string(grid[i][j]);
+            }
+        }
+    }
+
+    // Add givens taken from target to puzzle until target is its only solution, and return how many
+    // were added. Each round enumerates up to REPAIR_SOLUTIONS other solutions, then greedily adds the
+    // given that rules out the most of them until none is left (set cover); the next round verifies.
+    // A round that runs out of budget search nodes without finding another solution adds random
+    // givens instead, four times as many as the last such round up to 2N, which is what keeps
+    // generating sparse big boards from spending minutes on rounds that find nothing.
+    // Callers that must not add needless givens, like --repair, pass an unlimited budget.
+    int repairPuzzle(Grid &puzzle, const Grid &target, long long budget)
+    {
+        int added = 0;
+        int batch = 1; // Random givens the next round that runs out of budget adds
+        nodeBudget = budget;
+        while (true)
+        {
+            repairSolutions.clear();
+            enumerateSolutions(puzzle, REPAIR_SOLUTIONS, repairSolutions);
+            for (size_t k = 0; k < repairSolutions.size(); k++)
+            {
+                if (repairSolutions[k] == target)
+                {
+                    repairSolutions.erase(repairSolutions.begin() + k);
+                    break;
+                }
+            }
+            if (repairSolutions.empty() && solveNodes <= nodeBudget)
+            {
+                nodeBudget = numeric_limits<long long>::max();
+                return added;
+            }
+            if (repairSolutions.empty())
+            {
+                for (int k = 0; k < batch && countEmpty(puzzle) > 0; k++)
+                {
+                    int cell;
+                    do
+                    {
+                        cell = randomGenerator(N * N) - 1;
+                    } while (puzzle[cell / N][cell % N] != 0);
+                    puzzle[cell / N][cell % N] = target[cell / N][cell % N];
+                    added++;
+                }
+                batch = min(4 * batch, 2 * N);
+                continue;
+            }
+
+            while (!repairSolutions.empty())
+            {
+                int bestCell = -1, bestCount = 0;
+                for (int cell = 0; cell < N * N; cell++)
+                {
+                    int i = cell / N;
+                    int j = cell % N;
+                    if (puzzle[i][j] != 0)
+                        continue;
+                    int count = 0;
+                    for (size_t k = 0; k < repairSolutions.size(); k++)
+                    {
+                        if (repairSolutions[k][i][j] != target[i][j])
+                            count++;
+                    }
+                    if (count > bestCount)
+                    {
+                        bestCell = cell;
+                        bestCount = count;
+                    }
+                }
+
+                int i = bestCell / N;
+                int j = bestCell % N;
+                puzzle[i][j] = target[i][j];
+                added++;
+                size_t kept = 0;
+                for (size_t k = 0; k < repairSolutions.size(); k++)
+                {
+                    if (repairSolutions[k][i][j] == target[i][j])
+                        repairSolutions[kept++] = repairSolutions[k];
+                }
+                repairSolutions.resize(kept);
+            }
+        }
+    }
+
+    // Backtracking search. With BRANCH_HIDDEN_SINGLE it branches on whichever is narrower: the empty
+    // cell with the fewest candidates, or the (unit, digit) pair with the fewest places left.
+    // BRANCH_CELL only looks at cells, and BRANCH_FIRST_EMPTY takes cells in row order.
+    // With trialPruning set, every node first runs propagateSingles() and trialPropagation().
+    // Variant constraints affected since the last node are re-run first, and again after those.
+    int searchSolutions(int limit, Grid *solution, vector<Grid> *solutions)
+    {
+        // Past the budget, give up and report as many solutions as were asked for
+        if (++solveNodes > nodeBudget)
+            return limit;
+        if (!trialPruning && constraints.empty())
+            return branchSolutions(limit, solution, solutions);
+
+        int mark = trailSize;
+        size_t narrowMark = narrowed.size();
+        int found = 0;
+        if (propagateConstraints() && (!trialPruning || (propagateSingles(N * N) && trialPropagation(TRIAL_STEPS, TRIAL_BUDGET) >= 0 && propagateConstraints())))
+            found = branchSolutions(limit, solution, solutions);
+        undoTrail(mark);
+        undoNarrowing(narrowMark);
+        return found;
+    }
+
+    // Candidates of empty cell (i, j) in the solver state
+    Mask candidates(int i, int j)
+    {
+        return ~(rowMask[i] | colMask[j] | boxMask[boxIndex(i, j)]) & allowed[i * N + j];
+    }
+
+    // Queue the constraints in through, the cellConstraints or peerConstraints of a cell, to be re-run
+    void markDirty(const vector<int> &through)
+    {
+        for (size_t t = 0; t < through.size(); t++)
+        {
+            if (!queued[through[t]])
+            {
+                queued[through[t]] = 1;
+                dirty.push_back(through[t]);
+            }
+        }
+    }
+
+    // Re-run queued constraints until the queue is empty. Every cell a constraint narrows goes on the
+    // narrowed trail and queues the constraints through it in turn, so only affected constraints
+    // re-run. Returns false, with the queue emptied, once some cell is left with no candidate.
+    bool propagateConstraints()
+    {
+        Mask dom[N + 1];
+        while (!dirty.empty())
+        {
+            int index = dirty.back();
+            dirty.pop_back();
+            queued[index] = 0;
+            const Constraint &c = constraints[index];
+            for (size_t k = 0; k < c.cells.size(); k++)
+            {
+                int i = c.cells[k] / N, j = c.cells[k] % N;
+                dom[k] = work[i][j] != 0 ? digitBit(work[i][j]) : candidates(i, j);
+            }
+            if (!narrowConstraint(c, dom))
+            {
+                while (!dirty.empty())
+                {
+                    queued[dirty.back()] = 0;
+                    dirty.pop_back();
+                }
+                return false;
+            }
+            for (size_t k = 0; k < c.cells.size(); k++)
+            {
+                int cell = c.cells[k];
+                if (work[cell / N][cell % N] != 0 || dom[k] == candidates(cell / N, cell % N))
+                    continue; // Placed digits cannot narrow without emptying, which was caught above
+                narrowed.push_back(make_pair(cell, allowed[cell]));
+                allowed[cell] &= dom[k];
+                markDirty(cellConstraints[cell]);
+            }
+        }
+        return true;
+    }
+
+    // Take back every narrowing made since the narrowed trail had size mark
+    void undoNarrowing(size_t mark)
+    {
+        while (narrowed.size() > mark)
+        {
+            allowed[narrowed.back().first] = narrowed.back().second;
+            narrowed.pop_back();
+        }
+    }
+
+    // Pick the branch for searchSolutions and try each way of filling it. While cells under variant
+    // constraints are open they go first, since that is where dead ends show up on sparse boards;
+    // elsewhere only forced moves are taken until then.
+    int branchSolutions(int limit, Grid *solution, vector<Grid> *solutions)
+    {
+        int bestI = -1, bestJ = -1, bestCount = N + 1, bestRank = 2 * N + 1;
+        for (int i = 0; i < N && bestRank > 1; i++)
+        {
+            for (int j = 0; j < N; j++)
+            {
+                if (work[i][j] != 0)
+                    continue;
+                Mask free = candidates(i, j);
+                int count = countBits(free);
+                if (count == 0)
+                    return 0; // Dead end
+                int rank = count > 1 && !constraints.empty() && cellConstraints[i * N + j].empty() ? count + N : count;
+                if (rank < bestRank)
+                {
+                    bestI = i;
+                    bestJ = j;
+                    bestCount = count;
+                    bestRank = rank;
+                    if (count == 1 || branching == BRANCH_FIRST_EMPTY)
+                    {
+                        bestRank = 1; // Stop scanning
+                        break;
+                    }
+                }
+            }
+        }
+        if (bestI < 0)
+        {
+            if (solution != nullptr)
+                *solution = work;
+            if (solutions != nullptr)
+                solutions->push_back(work);
+            return 1;
+        }
+
+        int found = 0;
+        if (branching == BRANCH_HIDDEN_SINGLE && bestRank > 1)
+        {
+            // Count the places left for every digit in every unit: rows, then columns, then boxes.
+            // The counts live in the board rather than on the stack, so deep searches on big boards
+            // do not run out of it; nothing reads them once the branch is picked.
+            for (int unit = 0; unit < 3 * N; unit++)
+            {
+                for (int num = 1; num <= N; num++)
+                    places[unit][num] = 0;
+            }
+            for (int i = 0; i < N; i++)
+            {
+                for (int j = 0; j < N; j++)
+                {
+                    if (work[i][j] != 0)
+                        continue;
+                    for (Mask rest = candidates(i, j); rest != 0; rest &= rest - 1)
+                    {
+                        int num = lowestDigit(rest);
+                        places[i][num]++;
+                        places[N + j][num]++;
+                        places[2 * N + boxIndex(i, j)][num]++;
+                    }
+                }
+            }
+
+            int bestUnit = -1, bestNum = 0;
+            if (!constraints.empty() && bestRank <= N)
+                bestCount = 2; // A cell under a constraint is open
+            for (int unit = 0; unit < 3 * N; unit++)
+            {
+                Mask placed = unit < N ? rowMask[unit] : unit < 2 * N ? colMask[unit - N] : boxMask[unit - 2 * N];
+                for (int num = 1; num <= N; num++)
+                {
+                    if (placed & digitBit(num))
+                        continue;
+                    if (places[unit][num] == 0)
+                        return 0; // This digit has nowhere left to go
+                    if (places[unit][num] < bestCount)
+                    {
+                        bestUnit = unit;
+                        bestNum = num;
+                        bestCount = places[unit][num];
+                    }
+                }
+            }
+
+            if (bestUnit >= 0)
+            {
+                int offset = randomOrder ? randomGenerator(N) - 1 : 0;
+                for (int k = 0; k < N && found < limit; k++)
+                {
+                    int i, j;
+                    unitCell(bestUnit, (k + offset) % N, i, j);
+                    if (work[i][j] == 0 && (candidates(i, j) & digitBit(bestNum)))
+                        found += placeAndSearch(i, j, bestNum, limit - found, found == 0 ? solution : nullptr, solutions);
+                }
+                return found;
+            }
+        }
+
+        Mask bestFree = candidates(bestI, bestJ);
+        int offset = randomOrder ? randomGenerator(N) - 1 : 0;
+        for (int k = 0; k < N && found < limit; k++)
+        {
+            int num = (k + offset) % N + 1;
+            if (bestFree & digitBit(num))
+                found += placeAndSearch(bestI, bestJ, num, limit - found, found == 0 ? solution : nullptr, solutions);
+        }
+        return found;
+    }
+
+    // Put num in cell (i, j) of the solver state and record it on the trail so it can be undone
+    void trailPlace(int i, int j, int num)
+    {
+        Mask bit = digitBit(num);
+        work[i][j] = num;
+        rowMask[i] |= bit;
+        colMask[j] |= bit;
+        boxMask[boxIndex(i, j)] |= bit;
+        trail[trailSize++] = i * N + j;
+        if (!constraints.empty())
+            markDirty(peerConstraints[i * N + j]);
+    }
+
+    // Take back every placement recorded on the trail since it had size mark
+    void undoTrail(int mark)
+    {
+        while (trailSize > mark)
+        {
+            int cell = trail[--trailSize];
+            int i = cell / N;
+            int j = cell % N;
+            Mask bit = digitBit(work[i][j]);
+            rowMask[i] &= ~bit;
+            colMask[j] &= ~bit;
+            boxMask[boxIndex(i, j)] &= ~bit;
+            work[i][j] = 0;
+        }
+    }
+
+    // Set up fillPlaces for the grid loaded by startSearch and queue every forced move, including
+    // unit digits with no place left, which fillPropagate reports as contradictions
+    void fillStart()
+    {
+        for (int unit = 0; unit < 3 * N; unit++)
+        {
+            for (int num = 1; num <= N; num++)
+                fillPlaces[unit][num] = 0;
+        }
+        fillQueue.clear();
+        for (int i = 0; i < N; i++)
+        {
+            for (int j = 0; j < N; j++)
+            {
+                if (work[i][j] != 0)
+                    continue;
+                Mask free = ~(rowMask[i] | colMask[j] | boxMask[boxIndex(i, j)]) & ALL_CANDIDATES;
+                if ((free & (free - 1)) == 0)
+                    fillQueue.push_back(i * N + j);
+                for (; free != 0; free &= free - 1)
+                {
+                    int num = lowestDigit(free);
+                    fillPlaces[i][num]++;
+                    fillPlaces[N + j][num]++;
+                    fillPlaces[2 * N + boxIndex(i, j)][num]++;
+                }
+            }
+        }
+        for (int unit = 0; unit < 3 * N; unit++)
+        {
+            Mask placed = unit < N ? rowMask[unit] : unit < 2 * N ? colMask[unit - N] : boxMask[unit - 2 * N];
+            for (int num = 1; num <= N; num++)
+            {
+                if (!(placed & digitBit(num)) && fillPlaces[unit][num] <= 1)
+                    fillQueue.push_back(N * N + unit * (N + 1) + num);
+            }
+        }
+    }
+
+    // Add delta to the places of num in the three units of cell (i, j). On the way down, queue the
+    // units where num has one place left, and return false where it has none.
+    bool fillCount(int i, int j, int num, int delta)
+    {
+        int units[3] = {i, N + j, 2 * N + boxIndex(i, j)};
+        Mask placed[3] = {rowMask[i], colMask[j], boxMask[boxIndex(i, j)]};
+        bool ok = true;
+        for (int k = 0; k < 3; k++)
+        {
+            int left = fillPlaces[units[k]][num] += delta;
+            if (delta > 0 || (placed[k] & digitBit(num)))
+                continue;
+            if (left == 1)
+                fillQueue.push_back(N * N + units[k] * (N + 1) + num);
+            ok = ok && left > 0;
+        }
+        return ok;
+    }
+
+    // The empty cells sharing a unit with cell (i, j) that still have num as a candidate.
+    // Returns how many were written to peers.
+    int fillPeers(int i, int j, int num, int *peers)
+    {
+        int count = 0;
+        int rowStart = i - i % MINI_BOX_SIZE, colStart = j - j % MINI_BOX_SIZE;
+        for (int k = 0; k < N; k++)
+        {
+            int cells[3] = {i * N + k, k * N + j, (rowStart + k / MINI_BOX_SIZE) * N + colStart + k % MINI_BOX_SIZE};
+            for (int c = 0; c < 3; c++)
+            {
+                int r = cells[c] / N, q = cells[c] % N;
+                if ((r == i && q == j) || (c == 2 && (r == i || q == j)) || work[r][q] != 0)
+                    continue; // The cell itself, or a box cell already seen in the row or column
+                if (!((rowMask[r] | colMask[q] | boxMask[boxIndex(r, q)]) & digitBit(num)))
+                    peers[count++] = cells[c];
+            }
+        }
+        return count;
+    }
+
+    // Put num in cell (i, j) for fillSearch, keeping fillPlaces up to date and queueing the cells and
+    // units it leaves forced. Returns false if it leaves a cell or a unit digit with no option, but
+    // always finishes the bookkeeping so fillUndo can take it back.
+    bool fillPlace(int i, int j, int num)
+    {
+        int peers[3 * N];
+        int peerCount = fillPeers(i, j, num, peers);
+        Mask others = ~(rowMask[i] | colMask[j] | boxMask[boxIndex(i, j)]) & ALL_CANDIDATES & ~digitBit(num);
+        trailPlace(i, j, num);
+
+        bool ok = true;
+        for (; others != 0; others &= others - 1)
+            ok = fillCount(i, j, lowestDigit(others), -1) && ok;
+        for (int k = 0; k < peerCount; k++)
+        {
+            int r = peers[k] / N, q = peers[k] % N;
+            ok = fillCount(r, q, num, -1) && ok;
+            Mask free = ~(rowMask[r] | colMask[q] | boxMask[boxIndex(r, q)]) & ALL_CANDIDATES;
+            if (free == 0)
+                ok = false;
+            else if ((free & (free - 1)) == 0)
+                fillQueue.push_back(peers[k]);
+        }
+        return ok;
+    }
+
+    // Take back the fillPlace calls made since the trail had size mark, and drop the queued moves
+    void fillUndo(int mark)
+    {
+        int peers[3 * N];
+        while (trailSize > mark)
+        {
+            int cell = trail[trailSize - 1];
+            int i = cell / N, j = cell % N;
+            int num = work[i][j];
+            undoTrail(trailSize - 1);
+            Mask others = ~(rowMask[i] | colMask[j] | boxMask[boxIndex(i, j)]) & ALL_CANDIDATES & ~digitBit(num);
+            for (; others != 0; others &= others - 1)
+                fillCount(i, j, lowestDigit(others), 1);
+            int peerCount = fillPeers(i, j, num, peers);
+            for (int k = 0; k < peerCount; k++)
+                fillCount(peers[k] / N, peers[k] % N, num, 1);
+        }
+        fillQueue.clear();
+    }
+
+    // Make the queued forced moves, and the ones they lead to, until none is left.
+    // Returns false on a contradiction.
+    bool fillPropagate()
+    {
+        while (!fillQueue.empty())
+        {
+            int item = fillQueue.back();
+            fillQueue.pop_back();
+            if (item < N * N)
+            {
+                int i = item / N, j = item % N;
+                if (work[i][j] != 0)
+                    continue;
+                Mask free = ~(rowMask[i] | colMask[j] | boxMask[boxIndex(i, j)]) & ALL_CANDIDATES;
+                if (free == 0)
+                    return false;
+                if ((free & (free - 1)) == 0 && !fillPlace(i, j, lowestDigit(free)))
+                    return false;
+                continue;
+            }
+
+            int unit = (item - N * N) / (N + 1), num = (item - N * N) % (N + 1);
+            Mask placed = unit < N ? rowMask[unit] : unit < 2 * N ? colMask[unit - N] : boxMask[unit - 2 * N];
+            if ((placed & digitBit(num)) || fillPlaces[unit][num] > 1)
+                continue;
+            if (fillPlaces[unit][num] == 0)
+                return false;
+            for (int k = 0; k < N; k++)
+            {
+                int i, j;
+                unitCell(unit, k, i, j);
+                if (work[i][j] == 0 && !((rowMask[i] | colMask[j] | boxMask[boxIndex(i, j)]) & digitBit(num)))
+                {
+                    if (!fillPlace(i, j, num))
+                        return false;
+                    break;
+                }
+            }
+        }
+        return true;
+    }
+
+    // Complete the grid loaded by startSearch and fillStart: propagate forced moves, then branch on
+    // the cell with the fewest candidates, trying them from a random start. Unlike searchSolutions,
+    // which rescans the board at every node, each placement only updates the places of the cells it
+    // touches, which is what makes propagation affordable on boards up to 64x64. On success work holds
+    // the grid; returns false on a dead end or once nodeBudget nodes are spent.
+    bool fillSearch()
+    {
+        if (++solveNodes > nodeBudget)
+            return false;
+        int mark = trailSize;
+        if (!fillPropagate())
+        {
+            fillUndo(mark);
+            return false;
+        }
+
+        int bestI = -1, bestJ = -1, bestCount = N + 1;
+        for (int i = 0; i < N && bestCount > 2; i++)
+        {
+            for (int j = 0; j < N; j++)
+            {
+                if (work[i][j] != 0)
+                    continue;
+                int count = countBits(~(rowMask[i] | colMask[j] | boxMask[boxIndex(i, j)]) & ALL_CANDIDATES);
+                if (count < bestCount)
+                {
+                    bestI = i;
+                    bestJ = j;
+                    bestCount = count;
+                }
+            }
+        }
+        if (bestI < 0)
+            return true;
+
+        Mask free = ~(rowMask[bestI] | colMask[bestJ] | boxMask[boxIndex(bestI, bestJ)]) & ALL_CANDIDATES;
+        int offset = randomGenerator(N) - 1;
+        for (int k = 0; k < N && solveNodes <= nodeBudget; k++)
+        {
+            int num = (k + offset) % N + 1;
+            if (!(free & digitBit(num)))
+                continue;
+            int branchMark = trailSize;
+            if (fillPlace(bestI, bestJ, num) && fillSearch())
+                return true;
+            fillUndo(branchMark);
+        }
+        fillUndo(mark);
+        return false;
+    }
+
+    // Place naked singles (cells with one candidate) and hidden singles (digits with one place
+    // left in a unit) until there are none, or maxSteps have been placed. Every placement goes on
+    // the trail. Returns false if a cell or a unit digit runs out of options.
+    bool propagateSingles(int maxSteps)
+    {
+        int steps = 0;
+        bool changed = true;
+        while (changed && steps < maxSteps)
+        {
+            changed = false;
+            for (int i = 0; i < N; i++)
+            {
+                for (int j = 0; j < N; j++)
+                {
+                    if (work[i][j] != 0)
+                        continue;
+                    Mask free = candidates(i, j);
+                    if (free == 0)
+                        return false;
+                    if ((free & (free - 1)) == 0 && steps < maxSteps)
+                    {
+                        trailPlace(i, j, lowestDigit(free));
+                        steps++;
+                        changed = true;
+                    }
+                }
+            }
+
+            for (int unit = 0; unit < 3 * N && steps < maxSteps; unit++)
+            {
+                // Digits seen in one cell of the unit, and digits seen in more than one
+                Mask once = 0, twice = 0;
+                for (int k = 0; k < N; k++)
+                {
+                    int i, j;
+                    unitCell(unit, k, i, j);
+                    Mask free = work[i][j] != 0 ? digitBit(work[i][j]) : candidates(i, j);
+                    twice |= once & free;
+                    once |= free;
+                }
+                if (once != ALL_CANDIDATES)
+                    return false; // Some digit has no place left in this unit
+                for (Mask single = once & ~twice; single != 0 && steps < maxSteps; single &= single - 1)
+                {
+                    int num = lowestDigit(single);
+                    for (int k = 0; k < N; k++)
+                    {
+                        int i, j;
+                        unitCell(unit, k, i, j);
+                        if (work[i][j] == 0 && (candidates(i, j) & digitBit(num)))
+                        {
+                            trailPlace(i, j, num);
+                            steps++;
+                            changed = true;
+                            break;
+                        }
+                    }
+                }
+            }
+        }
+        return true;
+    }
+
+    // Nishio-style forcing: in every cell with exactly two candidates, tentatively place each one
+    // and propagate singles for at most maxSteps placements. A candidate that runs into a
+    // contradiction is ruled out, so the other one is placed; placements both branches agree on are
+    // placed as well. Work happens on the trail instead of board copies, and trialCost counts every
+    // tentative placement; once budget more have been made, no further cells are tried.
+    // Returns the placements made, or -1 if both candidates of a cell fail.
+    int trialPropagation(int maxSteps, long long budget)
+    {
+        long long stop = trialCost + budget;
+        int deductions = 0;
+        int firstValue[N * N]; // What the first branch placed in each cell, 0 where it placed nothing
+        for (int cell = 0; cell < N * N; cell++)
+            firstValue[cell] = 0;
+
+        for (int i = 0; i < N; i++)
+        {
+            for (int j = 0; j < N; j++)
+            {
+                if (work[i][j] != 0)
+                    continue;
+                Mask free = candidates(i, j);
+                if (countBits(free) != 2)
+                    continue;
+                if (trialCost >= stop)
+                    return deductions;
+                int first = lowestDigit(free);
+                int second = lowestDigit(free & (free - 1));
+
+                int mark = trailSize;
+                trailPlace(i, j, first);
+                bool firstHolds = propagateSingles(maxSteps);
+                trialCost += trailSize - mark;
+                int firstCells[N * N];
+                int firstCount = 0;
+                for (int t = mark; t < trailSize; t++)
+                {
+                    firstCells[firstCount++] = trail[t];
+                    firstValue[trail[t]] = work[trail[t] / N][trail[t] % N];
+                }
+                undoTrail(mark);
+
+                trailPlace(i, j, second);
+                bool secondHolds = propagateSingles(maxSteps);
+                trialCost += trailSize - mark;
+
+                if (!firstHolds && !secondHolds)
+                {
+                    undoTrail(mark);
+                    return -1;
+                }
+                if (!firstHolds)
+                {
+                    // The second candidate is forced, keep its branch as it stands
+                    deductions += trailSize - mark;
+                }
+                else if (!secondHolds)
+                {
+                    undoTrail(mark);
+                    trailPlace(i, j, first);
+                    propagateSingles(maxSteps);
+                    deductions += trailSize - mark;
+                }
+                else
+                {
+                    // Keep only the placements both branches agree on
+                    int agreed[N * N];
+                    int agreedCount = 0;
+                    for (int t = mark; t < trailSize; t++)
+                    {
+                        if (firstValue[trail[t]] == work[trail[t] / N][trail[t] % N])
+                            agreed[agreedCount++] = trail[t];
+                    }
+                    for (int k = 0; k < agreedCount; k++)
+                        agreed[k] = agreed[k] * (N + 1) + work[agreed[k] / N][agreed[k] % N]; // Pack the value in
+                    undoTrail(mark);
+                    for (int k = 0; k < agreedCount; k++)
+                    {
+                        int cell = agreed[k] / (N + 1);
+                        trailPlace(cell / N, cell % N, agreed[k] % (N + 1));
+                    }
+                    deductions += agreedCount;
+                }
+
+                for (int k = 0; k < firstCount; k++)
+                    firstValue[firstCells[k]] = 0;
+            }
+        }
+        return deductions;
+    }
+
+    // Rate grid by the techniques it needs: TECHNIQUE_SINGLES if naked and hidden singles solve it,
+    // TECHNIQUE_TRIAL if rounds of trial propagation are needed as well, TECHNIQUE_SEARCH if even
+    // that gets stuck, or -1 if it runs into a contradiction. trialRounds receives the rounds of
+    // trial propagation used and trialCost the tentative placements they made. All rounds together
+    // get TRIAL_BUDGET placements, and a puzzle that needs more counts as TECHNIQUE_SEARCH.
+    int rateTechnique(const Grid &grid, int &trialRounds)
+    {
+        trialRounds = 0;
+        trialCost = 0;
+        if (!startSearch(grid))
+            return -1;
+        while (true)
+        {
+            if (!propagateConstraints() || !propagateSingles(N * N))
+                return -1;
+            if (!dirty.empty())
+                continue; // The singles gave the constraints more to work with
+            if (trailSize == countEmpty(grid))
+                return trialRounds == 0 ? TECHNIQUE_SINGLES : TECHNIQUE_TRIAL;
+            int deductions = trialPropagation(TRIAL_STEPS, TRIAL_BUDGET - trialCost);
+            if (deductions < 0)
+                return -1;
+            if (deductions == 0)
+                return TECHNIQUE_SEARCH;
+            trialRounds++;
+        }
+    }
+
+    // Solve grid runs times with a random branching order and return a difficulty score from the
+    // search nodes each run needed beyond one per empty cell: log2 of the median excess, plus half
+    // the log2 ratio between the 90th and 10th percentile, since luck only matters when there are
+    // guesses to make. Singles-only puzzles score 0. Runs are split over up to workers threads,
+    // each with its own board and random engine. median receives the median node count.
+    // Returns -1 if grid has no solution, or -2 if a run spends more than nodeBudget nodes.
+    double estimateDifficulty(const Grid &grid, int runs, int workers, long long &median)
+    {
+        long long nodes[ESTIMATE_RUNS_MAX];
+        runs = max(1, min(runs, ESTIMATE_RUNS_MAX));
+        workers = max(1, min(workers, runs));
+        atomic<bool> unsolvable(false);
+        atomic<bool> gaveUp(false);
+        auto solveRuns = [&](SudokuBoard &board, int first) {
+            Grid solution;
+            board.randomOrder = true;
+            for (int r = first; r < runs && !unsolvable && !gaveUp; r += workers)
+            {
+                if (board.countSolutions(grid, 1, solution) == 0)
+                    unsolvable = true;
+                if (board.solveNodes > board.nodeBudget)
+                    gaveUp = true;
+                nodes[r] = board.solveNodes;
+            }
+            board.randomOrder = false;
+        };
+
+        vector<thread> threads;
+        for (int w = 1; w < workers; w++)
+        {
+            threads.push_back(thread([&, w]() {
+                SudokuBoard board;
+                board.branching = branching;
+                board.nodeBudget = nodeBudget;
+                for (size_t t = 0; t < constraints.size(); t++)
+                    board.addConstraint(constraints[t]);
+                solveRuns(board, w);
+            }));
+        }
+        solveRuns(*this, 0);
+        for (size_t w = 0; w < threads.size(); w++)
+            threads[w].join();
+        if (gaveUp)
+            return -2;
+        if (unsolvable)
+            return -1;
+
+        sort(nodes, nodes + runs);
+        median = nodes[runs / 2];
+        double base = static_cast<double>(countEmpty(grid));
+        double low = max(1.0, nodes[runs / 10] - base);
+        double high = max(1.0, nodes[runs - 1 - runs / 10] - base);
+        return log2(max(1.0, median - base)) + 0.5 * log2(high / low);
+    }
+
+    // Number of empty cells in grid
+    static int countEmpty(const Grid &grid)
+    {
+        int count = 0;
+        for (int i = 0; i < N; i++)
+        {
+            for (int j = 0; j < N; j++)
+            {
+                if (grid[i][j] == 0)
+                    count++;
+            }
+        }
+        return count;
+    }
+
+    // Put num in cell (i, j), search on, then take it back
+    int placeAndSearch(int i, int j, int num, int limit, Grid *solution, vector<Grid> *solutions)
+    {
+        Mask bit = digitBit(num);
+        int box = boxIndex(i, j);
+        work[i][j] = num;
+        rowMask[i] |= bit;
+        colMask[j] |= bit;
+        boxMask[box] |= bit;
+        if (!constraints.empty())
+            markDirty(peerConstraints[i * N + j]);
+        // Only the first solution is kept, later ones just need counting
+        int found = searchSolutions(limit, solution, solutions);
+        rowMask[i] &= ~bit;
+        colMask[j] &= ~bit;
+        boxMask[box] &= ~bit;
+        work[i][j] = 0;
+        return found;
+    }
+
+    // Append grid as an N*N-character line, '.' for empty cells
+    static void appendGrid(string &out, const Grid &grid)
+    {
+        for (int i = 0; i < N; i++)
+        {
+            for (int j = 0; j < N; j++)
+            {
+                out += valueChar(grid[i][j]);
+            }
+        }
+    }
+
+    // Apply a random transform to solved that keeps it a valid grid: swap two rows of a band,
+    // two columns of a stack, two bands, two stacks, or transpose
+    void transformSolution()
+    {
+        int kind = randomGenerator(5);
+        int first = randomGenerator(MINI_BOX_SIZE) - 1;
+        int second = randomGenerator(MINI_BOX_SIZE) - 1;
+        int offset = (randomGenerator(MINI_BOX_SIZE) - 1) * MINI_BOX_SIZE;
+        for (int k = 0; k < N; k++)
+        {
+            int t = k % MINI_BOX_SIZE;
+            switch (kind)
+            {
+            case 1:
+                swap(solved[offset + first][k], solved[offset + second][k]);
+                break;
+            case 2:
+                swap(solved[k][offset + first], solved[k][offset + second]);
+                break;
+            case 3:
+                if (k < MINI_BOX_SIZE)
+                    swap(solved[first * MINI_BOX_SIZE + t], solved[second * MINI_BOX_SIZE + t]);
+                break;
+            case 4:
+                for (int j = 0; j < MINI_BOX_SIZE; j++)
+                    swap(solved[k][first * MINI_BOX_SIZE + j], solved[k][second * MINI_BOX_SIZE + j]);
+                break;
+            default:
+                for (int j = k + 1; j < N; j++)
+                    swap(solved[k][j], solved[j][k]);
+                break;
+            }
+        }
+    }
+
+    // Search for a puzzle whose givens are exactly the cells set in mask and whose solution is unique.
+    // Each fresh grid is also tried under PATTERN_TRANSFORMS random transforms, which is much
+    // cheaper than generating a new one. attempts counts the grids checked; gives up once stop is set.
+    bool generateForMask(const bitset<N * N> &mask, const atomic<bool> &stop, atomic<long long> &attempts)
+    {
+        Grid ignored;
+        while (!stop)
+        {
+            resetBoard();
+            fillGrid();
+            solved = unsolved;
+            for (int t = 0; t < PATTERN_TRANSFORMS && !stop; t++)
+            {
+                for (int cell = 0; cell < N * N; cell++)
+                {
+                    unsolved[cell / N][cell % N] = mask[cell] ? solved[cell / N][cell % N] : 0;
+                }
+                attempts++;
+                if (countSolutions(unsolved, 2, ignored) == 1)
+                {
+                    emptyCells = N * N - static_cast<int>(mask.count());
+                    return true;
+                }
+                transformSolution();
+            }
+        }
+        return false;
+    }
+
+    // Reset the board to all 0s
+    void resetBoard()
+    {
+        for (int i = 0; i < N; i++)
+        {
+            for (int j = 0; j < N; j++)
+            {
+                unsolved[i][j] = 0;
+            }
+        }
+    }
+};
+
+void howToPlay()
+{
+    clearScreen();
+    cout << "==== How to Play ====\n\n";
+    cout << "Sudoku is a logic-based, combinatorial number-placement puzzle.\n\n";
+    const char *values = N <= 9 ? "digits" : "numbers";
+    cout << "The objective is to fill a " << N << "x" << N << " grid with " << values << " so that each column, each row, and each of the " << N << " " << MINI_BOX_SIZE
+         << "x" << MINI_BOX_SIZE << " subgrids that compose the grid contain all of the " << values << " from 1 to " << N << ".\n\n";
+    cout << "The puzzle setter provides a partially completed grid, which for a well-posed puzzle has a single solution.\n";
+    cout << "Completed puzzles are always a type of Latin square with an additional constraint on the contents of individual regions.\n\n";
+    cout << "For more information, visit: https://en.wikipedia.org/wiki/Sudoku \n\n";
+    system("pause");
+}
+
+void aboutDevelopers()
+{
+    clearScreen();
+    cout << "==== About Developers ====\n\n";
+    cout << "Developed by: \n";
+    cout << "1. SR Tamim - ID: 41230201087\n";
+    cout << "2. Mahatab Hossain - ID: 41230201189\n";
+    cout << "3. Tousif Mahabub - ID: 41230201026\n";
+    system("pause");
+}
+
+// Generate count puzzles and write them packed to an archive file. Records go in chunks of up to
+// ARCHIVE_CHUNK, each led by its length in bytes (4 bytes, little-endian), so readers can split the
+// file between threads without decoding it first.
+int archivePuzzles(const char *path, int count)
+{
+    ofstream file(path, ios::binary);
+    if (!file)
+    {
+        cerr << "Cannot open " << path << " for writing\n";
+        return 1;
+    }
+
+    SudokuBoard board;
+    vector<unsigned char> buffer(4 + ARCHIVE_CHUNK * ARCHIVE_RECORD_MAX);
+    size_t used = 4;
+    size_t total = 0;
+    for (int n = 0; n < count; n++)
+    {
+        board.emptyCells = MEDIUM_LVL;
+        board.resetBoard();
+        board.fillValues();
+        used += board.encodePuzzle(&buffer[used]);
+        if ((n + 1) % ARCHIVE_CHUNK == 0 || n == count - 1)
+        {
+            for (int k = 0; k < 4; k++)
+                buffer[k] = static_cast<unsigned char>((used - 4) >> (8 * k));
+            file.write(reinterpret_cast<const char *>(buffer.data()), used);
+            total += used;
+            used = 4;
+        }
+    }
+    cerr << "Archived " << count << " puzzles in " << total << " bytes\n";
+    return 0;
+}
+
+// Load a whole archive file into data with one read; size receives the file size
+bool readArchive(const char *path, vector<unsigned char> &data, size_t &size)
+{
+    ifstream file(path, ios::binary | ios::ate);
+    if (!file)
+    {
+        cerr << "Cannot open " << path << " for reading\n";
+        return false;
+    }
+    size = static_cast<size_t>(file.tellg());
+    // Pad the end so decodePuzzle can find a truncated last record without reading past the buffer
+    data.assign(size + ARCHIVE_RECORD_MAX, 0);
+    file.seekg(0);
+    if (!file.read(reinterpret_cast<char *>(data.data()), size))
+    {
+        cerr << "Cannot read " << path << "\n";
+        return false;
+    }
+    return true;
+}
+
+// Find the chunks of an archive loaded by readArchive: chunks receives where the records of each one
+// begin and end. Returns false, with an error, if a length prefix runs past the end of the file.
+bool splitArchive(const vector<unsigned char> &data, size_t size, vector<pair<size_t, size_t>> &chunks)
+{
+    for (size_t pos = 0; pos < size;)
+    {
+        size_t length = 0;
+        for (int k = 0; k < 4; k++)
+            length |= static_cast<size_t>(data[pos + k]) << (8 * k); // Padding makes a cut-off prefix readable
+        if (size - pos < 4 || length > size - pos - 4)
+        {
+            cerr << "Corrupt archive: chunk at byte " << pos << " runs past the end of the file\n";
+            return false;
+        }
+        chunks.push_back(make_pair(pos + 4, pos + 4 + length));
+        pos += 4 + length;
+    }
+    return true;
+}
+
+// Round-trip count generated puzzles through encodePuzzle and decodePuzzle and report any that come
+// back different, as a self-check of the archive format. Puzzles go through in batches laid out as
+// in an archive chunk, and only the decoding is timed, to report the rate --unarchive can reach.
+int checkArchive(int count)
+{
+    const int batch = 1024;
+    SudokuBoard board;
+    vector<Grid> puzzles(batch), solutions(batch);
+    vector<int> empty(batch);
+    vector<unsigned char> data(batch * ARCHIVE_RECORD_MAX + ARCHIVE_RECORD_MAX, 0); // Padded as readArchive does
+    chrono::duration<double> decoding(0);
+    int failures = 0;
+    for (int first = 0; first < count; first += batch)
+    {
+        int records = min(batch, count - first);
+        size_t size = 0;
+        for (int n = 0; n < records; n++)
+        {
+            board.emptyCells = MEDIUM_LVL;
+            board.resetBoard();
+            board.fillValues();
+            puzzles[n] = board.unsolved;
+            solutions[n] = board.solved;
+            empty[n] = board.emptyCells;
+            size += board.encodePuzzle(&data[size]);
+        }
+        fill(data.begin() + size, data.end(), 0);
+
+        // Stop at the first mismatch, since the records after it no longer line up
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        size_t pos = 0;
+        int n = 0;
+        for (; n < records; n++)
+        {
+            int used = board.decodePuzzle(&data[pos], size - pos);
+            if (used < 0 || board.unsolved != puzzles[n] || board.solved != solutions[n] || board.emptyCells != empty[n])
+                break;
+            pos += used;
+        }
+        decoding += chrono::steady_clock::now() - start;
+        if (n < records || pos != size)
+        {
+            string line = "Mismatch: ";
+            SudokuBoard::appendGrid(line, puzzles[min(n, records - 1)]);
+            cerr << line << "\n";
+            failures++;
+        }
+    }
+    cerr << "Round-tripped " << count << " puzzles, " << failures << " mismatches, decoding " << (decoding.count() > 0 ? count / decoding.count() : 0.0)
+         << " puzzles per second\n";
+    return failures == 0 ? 0 : 1;
+}
+
+// Decode an archive file and print each puzzle followed by its solution, one per line
+int unarchivePuzzles(const char *path)
+{
+    vector<unsigned char> data;
+    size_t size;
+    if (!readArchive(path, data, size))
+        return 1;
+
+    vector<pair<size_t, size_t>> chunks;
+    if (!splitArchive(data, size, chunks))
+        return 1;
+
+    SudokuBoard board;
+    string out;
+    long long count = 0;
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    for (size_t chunk = 0; chunk < chunks.size(); chunk++)
+    {
+        size_t end = chunks[chunk].second;
+        for (size_t pos = chunks[chunk].first; pos < end; count++)
+        {
+            int used = board.decodePuzzle(&data[pos], end - pos);
+            if (used < 0)
+            {
+                cout << out;
+                cerr << "Corrupt archive: record " << count + 1 << " at byte " << pos << " does not decode\n";
+                return 1;
+            }
+            pos += used;
+
+            SudokuBoard::appendGrid(out, board.unsolved);
+            out += ' ';
+            SudokuBoard::appendGrid(out, board.solved);
+            out += '\n';
+            if (out.size() > (1 << 20))
+            {
+                cout << out;
+                out.clear();
+            }
+        }
+    }
+    cout << out;
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    cerr << "Decoded and printed " << count << " puzzles in " << seconds * 1000 << " ms\n";
+    return 0;
+}
+
+// Find a unique puzzle whose givens sit exactly where maskText marks them ('x', '#' or '1'; '.', '-'
+// or '0' for empty), racing a randomized search on every core until one succeeds or seconds run out
+int generatePattern(const string &maskText, double seconds)
+{
+    bitset<N * N> mask;
+    int cells = 0;
+    for (size_t pos = 0; pos < maskText.size(); pos++)
+    {
+        char c = maskText[pos];
+        if (c == ' ' || c == '\t' || c == '\r' || c == '\n')
+            continue;
+        if (cells == N * N || (c != 'x' && c != 'X' && c != '#' && c != '1' && c != '.' && c != '-' && c != '0'))
+        {
+            cerr << "A mask is " << N * N << " cells of x, #, 1 (given) or ., -, 0 (empty)\n";
+            return 1;
+        }
+        mask[cells++] = c != '.' && c != '-' && c != '0';
+    }
+    if (cells != N * N)
+    {
+        cerr << "The mask has " << cells << " cells instead of " << N * N << "\n";
+        return 1;
+    }
+    if (N == 9 && mask.count() < 17)
+    {
+        cerr << "No 9x9 puzzle with fewer than 17 givens has a unique solution\n";
+        return 1;
+    }
+
+    int workers = max(1u, thread::hardware_concurrency());
+    vector<SudokuBoard> boards(workers);
+    atomic<bool> stop(false);
+    atomic<int> winner(-1);
+    atomic<long long> attempts(0);
+    vector<thread> threads;
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    for (int w = 0; w < workers; w++)
+    {
+        threads.push_back(thread([&, w]() {
+            if (boards[w].generateForMask(mask, stop, attempts))
+            {
+                int none = -1;
+                winner.compare_exchange_strong(none, w);
+                stop = true;
+            }
+        }));
+    }
+
+    chrono::steady_clock::time_point deadline = start + chrono::duration_cast<chrono::steady_clock::duration>(chrono::duration<double>(seconds));
+    while (!stop && chrono::steady_clock::now() < deadline)
+        this_thread::sleep_for(chrono::milliseconds(1));
+    stop = true;
+    for (size_t w = 0; w < threads.size(); w++)
+        threads[w].join();
+    double elapsed = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    cerr << attempts << " candidate puzzles checked in " << elapsed << " s\n";
+    if (winner < 0)
+    {
+        cerr << "No unique puzzle found for this mask in time\n";
+        return 1;
+    }
+    string out;
+    SudokuBoard::appendGrid(out, boards[winner].unsolved);
+    out += ' ';
+    SudokuBoard::appendGrid(out, boards[winner].solved);
+    cout << out << "\n";
+    return 0;
+}
+
+// Read puzzles from stdin, one per line, and print each with the fewest givens greedily added to make
+// its solution unique, followed by the number added. Puzzles without a solution are marked "unsolvable" and
+// followed by a minimal set of their givens that already clash. Lines are shared out to every core.
+int repairPuzzles()
+{
+    vector<string> lines;
+    string line;
+    while (getline(cin, line))
+        lines.push_back(line);
+
+    int workers = max(1u, thread::hardware_concurrency());
+    vector<string> results(lines.size());
+    atomic<size_t> next(0);
+    vector<thread> threads;
+    for (int w = 0; w < workers; w++)
+    {
+        threads.push_back(thread([&]() {
+            SudokuBoard board;
+            Grid puzzle, target;
+            for (size_t n = next++; n < lines.size(); n = next++)
+            {
+                if (!parseGrid(lines[n], puzzle))
+                {
+                    results[n] = lines[n] + " invalid";
+                    continue;
+                }
+                if (board.countSolutions(puzzle, 1, target) == 0)
+                {
+                    SudokuBoard::appendGrid(results[n], puzzle);
+                    results[n] += " unsolvable";
+                    board.explainContradiction(puzzle);
+                    SudokuBoard::appendGivens(results[n], puzzle);
+                    continue;
+                }
+                int added = board.repairPuzzle(puzzle, target, numeric_limits<long long>::max());
+                SudokuBoard::appendGrid(results[n], puzzle);
+                results[n] += " " + to_string(added);
+            }
+        }));
+    }
+    for (size_t w = 0; w < threads.size(); w++)
+        threads[w].join();
+
+    string out;
+    for (size_t n = 0; n < results.size(); n++)
+    {
+        out += results[n];
+        out += '\n';
+    }
+    cout << out;
+    return 0;
+}
+
+// Fill count complete grids of this build's size and report the time per grid and the restarts,
+// then generate count hard puzzles and report the time per puzzle and the empty cells kept
+int benchFill(int count)
+{
+    SudokuBoard board;
+    long long restarts = 0;
+    double slowest = 0;
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    for (int n = 0; n < count; n++)
+    {
+        chrono::steady_clock::time_point gridStart = chrono::steady_clock::now();
+        restarts += board.fillGrid();
+        slowest = max(slowest, chrono::duration<double>(chrono::steady_clock::now() - gridStart).count());
+    }
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    char row[128];
+    snprintf(row, sizeof(row), "%dx%d grids %d  mean ms %.3f  max ms %.3f  restarts per grid %.2f\n", N, N, count,
+             count > 0 ? seconds * 1000 / count : 0.0, slowest * 1000, count > 0 ? static_cast<double>(restarts) / count : 0.0);
+    cout << row;
+
+    // Then whole hard puzzles: a grid, its holes, and the repair that makes the solution unique
+    long long empty = 0;
+    slowest = 0;
+    start = chrono::steady_clock::now();
+    for (int n = 0; n < count; n++)
+    {
+        chrono::steady_clock::time_point puzzleStart = chrono::steady_clock::now();
+        board.emptyCells = HARD_LVL;
+        board.fillValues();
+        empty += board.emptyCells;
+        slowest = max(slowest, chrono::duration<double>(chrono::steady_clock::now() - puzzleStart).count());
+    }
+    seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    snprintf(row, sizeof(row), "%dx%d hard puzzles %d  mean ms %.3f  max ms %.3f  empty cells %.1f of %d\n", N, N, count,
+             count > 0 ? seconds * 1000 / count : 0.0, slowest * 1000, count > 0 ? static_cast<double>(empty) / count : 0.0, HARD_LVL);
+    cout << row;
+    return 0;
+}
+
+// Solve every puzzle read from stdin (one per line) with each branching strategy, proving uniqueness,
+// and compare the search nodes and time each strategy needs
+int benchSolver()
+{
+    vector<Grid> puzzles;
+    string line;
+    while (getline(cin, line))
+    {
+        Grid puzzle;
+        if (parseGrid(line, puzzle))
+            puzzles.push_back(puzzle);
+    }
+
+    // The last row is the hidden-single search with trial propagation at every node
+    const char *names[4] = {"first-empty", "cell", "hidden-single", "hidden+trial"};
+    SudokuBoard board;
+    board.nodeBudget = SOLVER_BENCH_NODE_BUDGET;
+    Grid solution;
+    cout << "strategy        puzzles  gave up   mean nodes    max nodes  mean us\n";
+    for (int strategy = BRANCH_FIRST_EMPTY; strategy <= BRANCH_HIDDEN_SINGLE + 1; strategy++)
+    {
+        board.branching = min(strategy, BRANCH_HIDDEN_SINGLE);
+        board.trialPruning = strategy > BRANCH_HIDDEN_SINGLE;
+        long long total = 0, most = 0, gaveUp = 0;
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        for (size_t n = 0; n < puzzles.size(); n++)
+        {
+            board.countSolutions(puzzles[n], 2, solution);
+            total += min(board.solveNodes, board.nodeBudget);
+            most = max(most, min(board.solveNodes, board.nodeBudget));
+            gaveUp += board.solveNodes > board.nodeBudget ? 1 : 0;
+        }
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        char row[128];
+        snprintf(row, sizeof(row), "%-15s %7zu %8lld %12.1f %12lld %8.1f\n", names[strategy], puzzles.size(), gaveUp,
+                 puzzles.empty() ? 0.0 : static_cast<double>(total) / puzzles.size(), most,
+                 puzzles.empty() ? 0.0 : seconds * 1e6 / puzzles.size());
+        cout << row;
+    }
+    return 0;
+}
+
+// Totals gathered by --analyze, one set per worker thread merged at the end
+struct CorpusStats
+{
+    CorpusStats()
+    {
+        puzzles = 0;
+        unique = 0;
+        for (int k = 0; k <= N * N; k++)
+            clueCounts[k] = 0;
+        for (int k = 0; k < 64; k++)
+            ratingCounts[k] = 0;
+        for (int cell = 0; cell < N * N; cell++)
+        {
+            clueCells[cell] = 0;
+            for (int num = 0; num <= N; num++)
+                digitCounts[cell][num] = 0;
+        }
+        for (int k = 0; k < 16; k++)
+            symmetryCounts[k] = 0;
+    }
+
+    long long puzzles;
+    long long unique;                    // Puzzles with exactly one solution
+    long long clueCounts[N * N + 1];     // By number of givens
+    long long ratingCounts[64];          // By log2 of solver search nodes
+    long long digitCounts[N * N][N + 1]; // Solution digit in each cell
+    long long clueCells[N * N];          // How often each cell is a given
+    long long symmetryCounts[16];        // By the set of symmetries the clue layout has
+
+    // Add one decoded puzzle; board provides the solver used for rating
+    void add(SudokuBoard &board)
+    {
+        Grid solution;
+        bool unique = board.countSolutions(board.unsolved, 2, solution) == 1;
+        int rating = 0;
+        while ((board.solveNodes >> rating) > 1)
+            rating++;
+
+        int symmetry = 0xF; // Rotation by 180 degrees, main diagonal, left-right and top-bottom mirror
+        for (int i = 0; i < N; i++)
+        {
+            for (int j = 0; j < N; j++)
+            {
+                bool given = board.unsolved[i][j] != 0;
+                if (given != (board.unsolved[N - 1 - i][N - 1 - j] != 0))
+                    symmetry &= ~1;
+                if (given != (board.unsolved[j][i] != 0))
+                    symmetry &= ~2;
+                if (given != (board.unsolved[i][N - 1 - j] != 0))
+                    symmetry &= ~4;
+                if (given != (board.unsolved[N - 1 - i][j] != 0))
+                    symmetry &= ~8;
+                digitCounts[i * N + j][board.solved[i][j]]++;
+                clueCells[i * N + j] += given ? 1 : 0;
+            }
+        }
+
+        puzzles++;
+        this->unique += unique ? 1 : 0;
+        clueCounts[N * N - board.emptyCells]++;
+        ratingCounts[rating]++;
+        symmetryCounts[symmetry]++;
+    }
+
+    void merge(const CorpusStats &other)
+    {
+        puzzles += other.puzzles;
+        unique += other.unique;
+        for (int k = 0; k <= N * N; k++)
+            clueCounts[k] += other.clueCounts[k];
+        for (int k = 0; k < 64; k++)
+            ratingCounts[k] += other.ratingCounts[k];
+        for (int cell = 0; cell < N * N; cell++)
+        {
+            clueCells[cell] += other.clueCells[cell];
+            for (int num = 0; num <= N; num++)
+                digitCounts[cell][num] += other.digitCounts[cell][num];
+        }
+        for (int k = 0; k < 16; k++)
+            symmetryCounts[k] += other.symmetryCounts[k];
+    }
+};
+
+// Scan an archive with every core and print the distributions the generator should keep even:
+// clue counts, ratings, uniqueness, solution digits and givens per cell, and clue layout symmetry
+int analyzePuzzles(const char *path, bool csv)
+{
+    vector<unsigned char> data;
+    size_t size;
+    if (!readArchive(path, data, size))
+        return 1;
+
+    // The chunk length prefixes let workers start at once, each decoding the chunks it takes
+    vector<pair<size_t, size_t>> chunks;
+    if (!splitArchive(data, size, chunks))
+        return 1;
+
+    int workers = max(1u, thread::hardware_concurrency());
+    vector<CorpusStats> stats(workers);
+    atomic<size_t> nextChunk(0);
+    atomic<size_t> corruptAt(size); // Byte of a record that does not decode, size while there is none
+    vector<thread> threads;
+    for (int w = 0; w < workers; w++)
+    {
+        threads.push_back(thread([&, w]() {
+            SudokuBoard board;
+            for (size_t chunk = nextChunk++; chunk < chunks.size() && corruptAt == size; chunk = nextChunk++)
+            {
+                size_t end = chunks[chunk].second;
+                for (size_t pos = chunks[chunk].first; pos < end;)
+                {
+                    int used = board.decodePuzzle(&data[pos], end - pos);
+                    if (used < 0)
+                    {
+                        corruptAt = pos;
+                        break;
+                    }
+                    pos += used;
+                    stats[w].add(board);
+                }
+            }
+        }));
+    }
+    for (size_t w = 0; w < threads.size(); w++)
+        threads[w].join();
+    if (corruptAt != size)
+    {
+        cerr << "Corrupt archive: record at byte " << corruptAt << " does not decode\n";
+        return 1;
+    }
+    for (int w = 1; w < workers; w++)
+        stats[0].merge(stats[w]);
+    CorpusStats &total = stats[0];
+
+    const char *symmetryNames[4] = {"rotational", "diagonal", "left_right", "top_bottom"};
+    string out;
+    if (csv)
+    {
+        out += "metric,key,count\n";
+        out += "puzzles,," + to_string(total.puzzles) + "\n";
+        out += "unique,," + to_string(total.unique) + "\n";
+        for (int k = 0; k <= N * N; k++)
+            if (total.clueCounts[k] != 0)
+                out += "clues," + to_string(k) + "," + to_string(total.clueCounts[k]) + "\n";
+        for (int k = 0; k < 64; k++)
+            if (total.ratingCounts[k] != 0)
+                out += "log2_solver_nodes," + to_string(k) + "," + to_string(total.ratingCounts[k]) + "\n";
+        for (int k = 0; k < 16; k++)
+        {
+            if (total.symmetryCounts[k] == 0)
+                continue;
+            string name;
+            for (int bit = 0; bit < 4; bit++)
+                if (k & (1 << bit))
+                    name += string(name.empty() ? "" : "+") + symmetryNames[bit];
+            out += "symmetry," + (name.empty() ? string("none") : name) + "," + to_string(total.symmetryCounts[k]) + "\n";
+        }
+        for (int cell = 0; cell < N * N; cell++)
+        {
+            string where = "r" + to_string(cell / N + 1) + "c" + to_string(cell % N + 1);
+            out += "given," + where + "," + to_string(total.clueCells[cell]) + "\n";
+            for (int num = 1; num <= N; num++)
+                out += "digit," + where + "=" + to_string(num) + "," + to_string(total.digitCounts[cell][num]) + "\n";
+        }
+    }
+    else
+    {
+        out += "{\n  \"puzzles\": " + to_string(total.puzzles) + ",\n  \"unique\": " + to_string(total.unique) + ",\n  \"clues\": {";
+        bool first = true;
+        for (int k = 0; k <= N * N; k++)
+        {
+            if (total.clueCounts[k] == 0)
+                continue;
+            out += string(first ? "" : ", ") + "\"" + to_string(k) + "\": " + to_string(total.clueCounts[k]);
+            first = false;
+        }
+        out += "},\n  \"log2_solver_nodes\": {";
+        first = true;
+        for (int k = 0; k < 64; k++)
+        {
+            if (total.ratingCounts[k] == 0)
+                continue;
+            out += string(first ? "" : ", ") + "\"" + to_string(k) + "\": " + to_string(total.ratingCounts[k]);
+            first = false;
+        }
+        out += "},\n  \"symmetry\": {";
+        first = true;
+        for (int k = 0; k < 16; k++)
+        {
+            if (total.symmetryCounts[k] == 0)
+                continue;
+            string name;
+            for (int bit = 0; bit < 4; bit++)
+                if (k & (1 << bit))
+                    name += string(name.empty() ? "" : "+") + symmetryNames[bit];
+            out += string(first ? "" : ", ") + "\"" + (name.empty() ? string("none") : name) + "\": " + to_string(total.symmetryCounts[k]);
+            first = false;
+        }
+        out += "},\n  \"givens_by_cell\": [";
+        for (int cell = 0; cell < N * N; cell++)
+            out += (cell == 0 ? "" : ", ") + to_string(total.clueCells[cell]);
+        out += "],\n  \"digits_by_cell\": [";
+        for (int cell = 0; cell < N * N; cell++)
+        {
+            out += cell == 0 ? "\n    [" : ",\n    [";
+            for (int num = 1; num <= N; num++)
+                out += (num == 1 ? "" : ", ") + to_string(total.digitCounts[cell][num]);
+            out += "]";
+        }
+        out += "\n  ]\n}\n";
+    }
+    cout << out;
+    return 0;
+}
+
+// One engine protocol session: the board being played and the scratch buffers used to answer commands
+struct EngineSession
+{
+    EngineSession()
+    {
+        loaded = false;
+    }
+
+    SudokuBoard board;
+    bool loaded; // Whether the board holds a puzzle yet
+    string command;
+
+    // Answer one protocol line by appending to reply, returns false once the client quits
+    bool handle(const string &line, string &reply)
+    {
+        size_t start = line.find_first_not_of(" \t\r");
+        if (start == string::npos)
+            return true;
+        size_t end = line.find_first_of(" \t\r", start);
+        if (end == string::npos)
+            end = line.size();
+        command.assign(line, start, end - start);
+        size_t argStart = line.find_first_not_of(" \t\r", end);
+        bool hasArgs = argStart != string::npos;
+
+        if (command == "isready")
+        {
+            reply += "readyok\n";
+        }
+        else if (command == "newgame")
+        {
+            board.variantConstraints = hasArgs && line.find("variant", argStart) != string::npos ? VARIANT_CONSTRAINTS : 0;
+            board.emptyCells = MEDIUM_LVL;
+            if (hasArgs && line.compare(argStart, 4, "easy") == 0)
+                board.emptyCells = EASY_LVL;
+            else if (hasArgs && line.compare(argStart, 4, "hard") == 0)
+                board.emptyCells = HARD_LVL;
+            board.resetBoard();
+            board.fillValues();
+            loaded = true;
+            reply += "position ";
+            SudokuBoard::appendGrid(reply, board.unsolved);
+            reply += '\n';
+        }
+        else if (command == "position")
+        {
+            if (!hasArgs)
+            {
+                if (loaded)
+                {
+                    reply += "position ";
+                    SudokuBoard::appendGrid(reply, board.unsolved);
+                    reply += '\n';
+                }
+                else
+                    reply += "error no position\n";
+                return true;
+            }
+
+            Grid grid;
+            if (!parseGrid(line, grid, argStart))
+            {
+                reply += "error bad position\n";
+                return true;
+            }
+
+            Grid solution;
+            int solutions = solve(grid, solution);
+            if (solutions < 0 && solution[0][0] == 0)
+            {
+                reply += "error too hard\n";
+                return true;
+            }
+            if (solutions == 0)
+            {
+                // Tell the client which givens clash
+                board.explainContradiction(grid);
+                reply += "error no solution";
+                SudokuBoard::appendGivens(reply, grid);
+                reply += '\n';
+                return true;
+            }
+            board.unsolved = grid;
+            board.solved = solution;
+            board.emptyCells = SudokuBoard::countEmpty(grid);
+            loaded = true;
+            reply += solutions < 0 ? "ok unknown\n" : solutions == 1 ? "ok\n" : "ok multiple\n";
+        }
+        else if (command == "constraint")
+        {
+            Constraint c;
+            if (hasArgs && line.compare(argStart, 5, "clear") == 0)
+            {
+                board.clearConstraints();
+                if (recheck(reply) < 0)
+                    reply += "ok unknown\n"; // The old solution still holds without the constraints
+            }
+            else if (!hasArgs || !parseConstraint(line, argStart, c))
+                reply += "error bad constraint\n";
+            else
+            {
+                board.addConstraint(c);
+                int solutions = recheck(reply);
+                if (solutions <= 0)
+                {
+                    board.removeLastConstraint();
+                    reply += solutions == 0 ? "error no solution\n" : "error too hard\n";
+                }
+            }
+        }
+        else if (command == "constraints")
+        {
+            reply += "constraints";
+            board.appendConstraints(reply);
+            reply += '\n';
+        }
+        else if (!loaded && (command == "move" || command == "hint" || command == "solve" || command == "rate"))
+        {
+            reply += "error no position\n";
+        }
+        else if (command == "move")
+        {
+            int move[3];
+            if (!hasArgs || parseNumbers(line, argStart, move, 3) != 3 || move[0] < 1 || move[0] > N || move[1] < 1 || move[1] > N || move[2] < 1 || move[2] > N)
+                reply += "error bad move\n";
+            else if (board.unsolved[move[0] - 1][move[1] - 1] != 0)
+                reply += "error cell filled\n";
+            else if (!board.constraintsAllow(move[0] - 1, move[1] - 1, move[2]))
+                reply += "error breaks constraint\n";
+            else
+            {
+                board.unsolved[move[0] - 1][move[1] - 1] = move[2];
+                reply += board.isBoardSolved() ? "solved\n" : "ok\n";
+            }
+        }
+        else if (command == "hint")
+        {
+            // Point at the empty cell with the fewest candidates, the easiest one to deduce
+            int bestI = -1, bestJ = -1, bestCount = N + 1;
+            for (int i = 0; i < N; i++)
+            {
+                for (int j = 0; j < N; j++)
+                {
+                    if (board.unsolved[i][j] != 0)
+                        continue;
+                    int count = 0;
+                    for (int num = 1; num <= N; num++)
+                    {
+                        if (board.checkIfSafe(i, j, num))
+                            count++;
+                    }
+                    if (count < bestCount)
+                    {
+                        bestI = i;
+                        bestJ = j;
+                        bestCount = count;
+                    }
+                }
+            }
+            if (bestI < 0)
+                reply += "error no empty cell\n";
+            else
+                reply += "hint " + to_string(bestI + 1) + " " + to_string(bestJ + 1) + " " + to_string(board.solved[bestI][bestJ]) + "\n";
+        }
+        else if (command == "solve")
+        {
+            reply += "solution ";
+            SudokuBoard::appendGrid(reply, board.solved);
+            reply += '\n';
+        }
+        else if (command == "rate")
+        {
+            const char *techniques[3] = {"singles", "trial", "search"};
+            int rounds;
+            int technique = board.rateTechnique(board.unsolved, rounds);
+            long long cost = board.trialCost;
+            // Only puzzles that need guessing take long enough per run to be worth the thread start-up
+            int workers = technique == TECHNIQUE_SEARCH ? static_cast<int>(max(1u, thread::hardware_concurrency())) : 1;
+            long long median = 0;
+            board.nodeBudget = ENGINE_NODE_BUDGET;
+            double score = technique < 0 ? -1 : board.estimateDifficulty(board.unsolved, ESTIMATE_RUNS, workers, median);
+            char scoreText[32];
+            snprintf(scoreText, sizeof(scoreText), "%.2f", score);
+            Grid solution;
+            int solutions = technique < 0 || score < -1 ? 0 : solve(board.unsolved, solution);
+            board.nodeBudget = numeric_limits<long long>::max();
+            if (technique < 0)
+                reply += "error no solution\n";
+            else if (score < -1 || solutions < 0)
+                reply += "error too hard\n";
+            else
+                reply += "rating technique " + string(techniques[technique]) + " trials " + to_string(rounds) + " cost " + to_string(cost) +
+                         " nodes " + to_string(board.solveNodes) + " empty " + to_string(board.emptyCells) + " score " + scoreText + " median " + to_string(median) + "\n";
+        }
+        else if (command == "quit")
+        {
+            return false;
+        }
+        else
+        {
+            reply += "error unknown command " + command + "\n";
+        }
+        return true;
+    }
+
+    // Count up to two solutions of grid within ENGINE_NODE_BUDGET search nodes, so no command keeps
+    // a client waiting for long. Returns -1 if the budget runs out first; solution then holds the
+    // first solution found, or stays all zeros if there was none.
+    int solve(const Grid &grid, Grid &solution)
+    {
+        solution = Grid();
+        board.nodeBudget = ENGINE_NODE_BUDGET;
+        int solutions = board.countSolutions(grid, 2, solution);
+        if (board.solveNodes > board.nodeBudget)
+            solutions = -1;
+        board.nodeBudget = numeric_limits<long long>::max();
+        return solutions;
+    }
+
+    // Re-solve the loaded position after the constraints changed and append "ok", "ok multiple" or,
+    // if a solution turned up before the budget ran out, "ok unknown", then return 1. Returns 0 if
+    // the position has no solution under them any more, or -1 if the budget ran out before a
+    // solution turned up, appending nothing in both cases.
+    int recheck(string &reply)
+    {
+        Grid solution;
+        int solutions = loaded ? solve(board.unsolved, solution) : 1;
+        if (solutions < 0 && solution[0][0] == 0)
+            return -1;
+        if (solutions == 0)
+            return 0;
+        if (loaded)
+            board.solved = solution;
+        reply += solutions < 0 ? "ok unknown\n" : solutions == 1 ? "ok\n" : "ok multiple\n";
+        return 1;
+    }
+
+    // Parse the arguments of a constraint command, starting at pos, into c: "thermo" or "arrow"
+    // followed by r<row>c<col> cells from the bulb or circle on, or "sandwich row|col <k> <sum>"
+    static bool parseConstraint(const string &line, size_t pos, Constraint &c)
+    {
+        vector<string> words;
+        while ((pos = line.find_first_not_of(" \t\r", pos)) != string::npos)
+        {
+            size_t end = line.find_first_of(" \t\r", pos);
+            if (end == string::npos)
+                end = line.size();
+            words.push_back(line.substr(pos, end - pos));
+            pos = end;
+        }
+        c.sum = 0;
+        c.cells.clear();
+
+        if (words[0] == "sandwich")
+        {
+            int values[2];
+            if (words.size() != 4 || (words[1] != "row" && words[1] != "col") || parseNumbers(words[2] + " " + words[3], 0, values, 2) != 2 ||
+                values[0] < 1 || values[0] > N || values[1] > (N - 2) * (N + 1) / 2)
+                return false;
+            c.kind = CONSTRAINT_SANDWICH;
+            c.sum = values[1];
+            for (int k = 0; k < N; k++)
+                c.cells.push_back(words[1] == "row" ? (values[0] - 1) * N + k : k * N + values[0] - 1);
+            return true;
+        }
+
+        if (words[0] != "thermo" && words[0] != "arrow")
+            return false;
+        c.kind = words[0] == "thermo" ? CONSTRAINT_THERMO : CONSTRAINT_ARROW;
+        size_t most = c.kind == CONSTRAINT_THERMO ? N : N + 1;
+        if (words.size() < 3 || words.size() - 1 > most)
+            return false;
+        for (size_t w = 1; w < words.size(); w++)
+        {
+            size_t split = words[w].find('c');
+            int values[2];
+            if (words[w][0] != 'r' || split == string::npos || parseNumbers(words[w].substr(1, split - 1) + " " + words[w].substr(split + 1), 0, values, 2) != 2 ||
+                values[0] < 1 || values[0] > N || values[1] < 1 || values[1] > N)
+                return false;
+            int cell = (values[0] - 1) * N + values[1] - 1;
+            if (find(c.cells.begin(), c.cells.end(), cell) != c.cells.end())
+                return false;
+            c.cells.push_back(cell);
+        }
+        return true;
+    }
+};
+
+// Run the line-based engine protocol on stdin/stdout so bots and GUIs can drive a board.
+// Replies are buffered and written once every pipelined command read so far has been answered.
+int runEngine()
+{
+    ios::sync_with_stdio(false);
+
+    EngineSession session;
+    string line, reply;
+    while (getline(cin, line))
+    {
+        if (!session.handle(line, reply))
+            break;
+
+        // Hold replies back while more commands are already waiting
+        if (cin.rdbuf()->in_avail() <= 0)
+        {
+            cout << reply;
+            cout.flush();
+            reply.clear();
+        }
+    }
+    cout << reply;
+    cout.flush();
+    return 0;
+}
+
+// Latency histogram in nanoseconds with 16 linear sub-buckets per power of two, so any
+// recorded value is reported to within about 6%
+struct LatencyHistogram
+{
+    LatencyHistogram()
+    {
+        counts.assign(16 + 60 * 16, 0);
+        total = 0;
+        maxValue = 0;
+    }
+
+    vector<long long> counts;
+    long long total;
+    long long maxValue;
+
+    void record(long long ns)
+    {
+        int bucket = static_cast<int>(ns);
+        if (ns >= 16)
+        {
+            int exponent = 0;
+            while ((ns >> exponent) >= 32)
+                exponent++;
+            bucket = 16 + exponent * 16 + static_cast<int>(ns >> exponent) - 16;
+        }
+        counts[bucket]++;
+        total++;
+        maxValue = max(maxValue, ns);
+    }
+
+    // Value that fraction of all samples are at or below, as the upper bound of its bucket but never
+    // past the largest value recorded
+    long long percentile(double fraction)
+    {
+        long long wanted = static_cast<long long>(fraction * total + 0.5);
+        long long seen = 0;
+        for (size_t bucket = 0; bucket < counts.size(); bucket++)
+        {
+            seen += counts[bucket];
+            if (seen >= wanted && seen > 0)
+            {
+                if (bucket < 16)
+                    return bucket;
+                int exponent = static_cast<int>(bucket - 16) / 16;
+                return min(static_cast<long long>(16 + (bucket - 16) % 16 + 1) << exponent, maxValue); // Bucket upper bound
+            }
+        }
+        return maxValue;
+    }
+};
+
+// Drive an in-process engine session with a random mix of requests and report latency per command.
+// weights give the share of newgame, move, hint, solve and rate requests. With perSecond > 0 the
+// requests follow a fixed schedule (open loop) and latency counts from the scheduled start, so
+// a slow request also charges the ones queued behind it instead of hiding them.
+int benchEngine(int requests, const int *weights, double perSecond)
+{
+    const char *names[5] = {"newgame", "move", "hint", "solve", "rate"};
+    int weightTotal = 0;
+    for (int k = 0; k < 5; k++)
+        weightTotal += weights[k];
+    if (requests <= 0 || weightTotal <= 0)
+    {
+        cerr << "Nothing to run\n";
+        return 1;
+    }
+
+    EngineSession session;
+    LatencyHistogram histograms[5];
+    string line, reply;
+    session.handle("newgame", reply);
+
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    for (int n = 0; n < requests; n++)
+    {
+        int pick = session.board.randomGenerator(weightTotal) - 1;
+        int kind = 0;
+        while (pick >= weights[kind])
+            pick -= weights[kind++];
+
+        line = names[kind];
+        if (kind == 1)
+        {
+            // Play a correct move into a random empty cell, or start over once the board is full
+            int first = session.board.randomGenerator(N * N) - 1;
+            int cell = -1;
+            for (int k = 0; k < N * N && cell < 0; k++)
+            {
+                if (session.board.unsolved[(first + k) % (N * N) / N][(first + k) % N] == 0)
+                    cell = (first + k) % (N * N);
+            }
+            if (cell < 0)
+                kind = 0;
+            line = cell < 0 ? "newgame" : "move " + to_string(cell / N + 1) + " " + to_string(cell % N + 1) + " " + to_string(session.board.solved[cell / N][cell % N]);
+        }
+
+        chrono::steady_clock::time_point begin = chrono::steady_clock::now();
+        if (perSecond > 0)
+        {
+            // Sleeping right up to the schedule wakes late and would charge the request for it,
+            // so sleep until just before and spin the rest of the way
+            chrono::steady_clock::time_point scheduled = start + chrono::duration_cast<chrono::steady_clock::duration>(chrono::duration<double>(n / perSecond));
+            if (begin < scheduled - chrono::microseconds(BENCH_SPIN_MICROSECONDS))
+                this_thread::sleep_until(scheduled - chrono::microseconds(BENCH_SPIN_MICROSECONDS));
+            while (chrono::steady_clock::now() < scheduled)
+            {
+            }
+            begin = scheduled;
+        }
+        session.handle(line, reply);
+        histograms[kind].record(chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - begin).count());
+        reply.clear();
+    }
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    cout << "command   count     p50 us     p90 us     p99 us   p99.9 us     max us\n";
+    for (int k = 0; k < 5; k++)
+    {
+        if (histograms[k].total == 0)
+            continue;
+        char row[128];
+        snprintf(row, sizeof(row), "%-8s %6lld %10.2f %10.2f %10.2f %10.2f %10.2f\n", names[k], histograms[k].total,
+                 histograms[k].percentile(0.5) / 1000.0, histograms[k].percentile(0.9) / 1000.0, histograms[k].percentile(0.99) / 1000.0,
+                 histograms[k].percentile(0.999) / 1000.0, histograms[k].maxValue / 1000.0);
+        cout << row;
+    }
+    cout << requests << " requests in " << seconds << " s (" << requests / seconds << " per second)\n";
+    return 0;
+}
 
-int main()
+int main(int argc, char *argv[])
 {
+    if (argc == 4 && string(argv[1]) == "--archive")
+        return archivePuzzles(argv[3], atoi(argv[2]));
+    if (argc == 3 && string(argv[1]) == "--unarchive")
+        return unarchivePuzzles(argv[2]);
+    if ((argc == 2 || argc == 3) && string(argv[1]) == "--archive-check")
+        return checkArchive(argc == 3 ? atoi(argv[2]) : 1000);
+    if ((argc == 3 || (argc == 4 && (string(argv[3]) == "json" || string(argv[3]) == "csv"))) && string(argv[1]) == "--analyze")
+        return analyzePuzzles(argv[2], argc == 4 && string(argv[3]) == "csv");
+    if ((argc == 3 || argc == 4) && string(argv[1]) == "--pattern")
+    {
+        // "-" reads the mask from stdin, so it can be drawn over several lines
+        string maskText = argv[2];
+        if (maskText == "-")
+            maskText.assign(istreambuf_iterator<char>(cin), istreambuf_iterator<char>());
+        return generatePattern(maskText, argc == 4 ? atof(argv[3]) : 10);
+    }
+    if (argc == 2 && string(argv[1]) == "--solver-bench")
+        return benchSolver();
+    if ((argc == 2 || argc == 3) && string(argv[1]) == "--fill-bench")
+        return benchFill(argc == 3 ? atoi(argv[2]) : 1000);
+    if (argc == 2 && string(argv[1]) == "--repair")
+        return repairPuzzles();
+    if (argc == 2 && string(argv[1]) == "--engine")
+        return runEngine();
+    if (argc >= 3 && argc <= 5 && string(argv[1]) == "--engine-bench")
+    {
+        int weights[5] = {2, 60, 20, 9, 9};
+        if (argc >= 4 && parseNumbers(argv[3], 0, weights, 5) != 5)
+        {
+            cerr << "The mix needs five weights: newgame,move,hint,solve,rate\n";
+            return 1;
+        }
+        return benchEngine(atoi(argv[2]), weights, argc == 5 ? atof(argv[4]) : 0);
+    }
+    if (argc > 1)
+    {
+        cerr << "Usage: " << argv[0] << " [--archive <count> <file> | --unarchive <file> | --archive-check [<count>] |\n"
+             << "       --analyze <file> [json|csv] | --pattern <mask>|- [<seconds>] | --repair | --solver-bench |\n"
+             << "       --fill-bench [<count>] | --engine |\n"
+             << "       --engine-bench <requests> [<newgame,move,hint,solve,rate weights> [<requests per second>]]]\n";
+        return 1;
+    }
+
     SudokuBoard board;
     cout << "Welcome to Sudoku!\n\n";
     system("pause");
@@ -313,7 +3178,8 @@ HomeScreen:
     cout << "4. Exit\n\n";
     cout << "Your choice: ";
     int choice;
-    cin >> choice;
+    if (!readNumber(choice))
+        goto ExitGame;
     switch (choice)
     {
     case 1:
@@ -339,8 +3205,6 @@ HomeScreen:
 StartGame:
     while (true)
     {
-        srand(static_cast<unsigned int>(time(0)));
-
         clearScreen();
 
         // Ask for difficulty level
@@ -350,7 +3214,8 @@ StartGame:
         cout << "3. Hard\n";
         cout << "Your choice: ";
         int choice;
-        cin >> choice;
+        if (!readNumber(choice))
+            goto ExitGame;
 
         switch (choice)
         {
@@ -377,18 +3242,41 @@ StartGame:
             clearScreen();
             board.printSudoku();
 
-            int row, col, val;
-            cout << "\nEnter row (1-9) (or 0 to quit): ";
-            cin >> row;
+            // A whole move can be typed on one line as "row column value"
+            int move[3];
+            int row = -1, col = -1, val = -1;
+            cout << "\nEnter row (1-" << N << "), or row column value (or 0 to quit): ";
+            int count = readNumbers(move, 3);
+            if (count < 0)
+                goto ExitGame;
+            if (count == 1 || count == 3)
+                row = move[0];
+            if (count == 3)
+            {
+                col = move[1];
+                val = move[2];
+            }
 
-            if (row == 0)
+            if (row == 0 || col == 0 || val == 0)
                 goto HomeScreen;
 
-            cout << "Enter column (1-9) (or 0 to quit): ";
-            cin >> col;
+            if (count == 1)
+            {
+                cout << "Enter column (1-" << N << ") (or 0 to quit): ";
+                if (!readNumber(col))
+                    goto ExitGame;
 
-            if (col == 0)
-                goto HomeScreen;
+                if (col == 0)
+                    goto HomeScreen;
+            }
+
+            // Validate the position before it is used to index the board
+            if (row < 1 || row > N || col < 1 || col > N)
+            {
+                cout << "Invalid input! Try again.\n";
+                system("pause");
+                continue;
+            }
 
             if (board.unsolved[row - 1][col - 1] != 0)
             {
@@ -397,13 +3285,17 @@ StartGame:
                 continue;
             }
 
-            cout << "Enter value (1-9) (or 0 to quit): ";
-            cin >> val;
+            if (count == 1)
+            {
+                cout << "Enter value (1-" << N << ") (or 0 to quit): ";
+                if (!readNumber(val))
+                    goto ExitGame;
 
-            if (val == 0)
-                goto HomeScreen;
+                if (val == 0)
+                    goto HomeScreen;
+            }
 
-            if (row < 1 || row > N || col < 1 || col > N || val < 1 || val > N)
+            if (val < 1 || val > N)
             {
                 cout << "Invalid input! Try again.\n";
                 system("pause");